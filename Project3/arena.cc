@@ -0,0 +1,92 @@
+/* File: arena.cc
+ * --------------
+ * Implementation of Arena. Blocks are chained newest first; the first
+ * is the one being bumped through. They start small, so that a short
+ * compilation does not pay for a big block, and double in size up to
+ * BlockSize. An allocation too big to share a block gets one to itself,
+ * chained in behind the current block so the room left in that is not
+ * wasted.
+ */
+
+#include <stdlib.h>
+#include <mutex>
+#include "arena.h"
+#include "utility.h"
+
+thread_local Arena *Arena::current = NULL;
+
+static std::mutex sharedLock;
+static Arena *shared = NULL;        // never freed: built-in types live in it
+
+Arena::Arena() : blocks(NULL), next(NULL), end(NULL), blockSize(FirstBlockSize),
+                 numAllocations(0), bytesAllocated(0), numBlocks(0) {
+}
+
+Arena::~Arena() {
+    Reset();
+    free(blocks);
+}
+
+void *Arena::AllocateBlock(size_t size, bool makeCurrent) {
+    Block *b = (Block *)malloc(sizeof(Block) + size);
+    if (!b) Failure("Out of memory");
+    b->size = size;
+    numBlocks++;
+    char *data = (char *)(b + 1);
+    if (makeCurrent || !blocks) {       // an oversized first block is
+        b->next = blocks;               // current too, but already full
+        blocks = b;
+        next = makeCurrent ? data : data + size;
+        end = data + size;
+    } else {
+        b->next = blocks->next;
+        blocks->next = b;
+    }
+    return data;
+}
+
+void *Arena::Allocate(size_t size) {
+    size = (size + Align - 1) & ~(Align - 1);
+    numAllocations++;
+    bytesAllocated += size;
+    if (size > (size_t)(end - next)) {
+        if (size > blockSize/4) return AllocateBlock(size, false);
+        AllocateBlock(blockSize, true);
+        if (blockSize < BlockSize) blockSize *= 2;
+    }
+    void *p = next;
+    next += size;
+    return p;
+}
+
+void Arena::Reset() {
+    if (!blocks) return;
+    while (blocks->next) {
+        Block *b = blocks->next;
+        blocks->next = b->next;
+        free(b);
+        numBlocks--;
+    }
+    next = (char *)(blocks + 1);
+    end = next + blocks->size;
+    numAllocations = bytesAllocated = 0;
+}
+
+Arena *Arena::SetCurrent(Arena *a) {
+    Arena *was = current;
+    current = a;
+    return was;
+}
+
+void *Arena::AllocateHere(size_t size) {
+    if (current) return current->Allocate(size);
+    std::lock_guard<std::mutex> lock(sharedLock);
+    if (!shared) shared = new Arena;
+    return shared->Allocate(size);
+}
+
+void Arena::PrintStats(const char *what) {
+    PrintDebug("arena", "%s: %lu allocations, %lu bytes in %d blocks", what,
+               (unsigned long)numAllocations, (unsigned long)bytesAllocated,
+               numBlocks);
+}
@@ -0,0 +1,67 @@
+/* File: arena.h
+ * -------------
+ * An Arena hands out memory by bumping a pointer through large blocks,
+ * and takes it all back at once: there is no freeing one allocation at
+ * a time. Each ParserSession has one, and every AST node and List of
+ * that compilation is allocated from it through their operator new, so
+ * the whole tree goes away with the session in a free() per block,
+ * however many nodes it has. Deleting a single node runs its destructor
+ * but gives no memory back.
+ *
+ * Nodes come from the arena current on the thread, which the session
+ * sets while it parses and checks. Nodes made with no arena current
+ * (the built-in types, made before main() runs) come from one shared
+ * arena that lasts as long as the process.
+ */
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+
+class Arena
+{
+  public:
+    static constexpr size_t FirstBlockSize = 4*1024;    // doubling up to
+    static constexpr size_t BlockSize = 64*1024;        // this
+    static constexpr size_t Align = 8;      // nodes hold nothing stricter
+                                            // than a pointer or a double
+    Arena();
+    ~Arena();
+
+        // size bytes, aligned to Align
+    void *Allocate(size_t size);
+
+        // Gives back everything allocated so far, keeping the first
+        // block for what comes next
+    void Reset();
+
+        // Makes a the arena this thread's nodes come from (NULL for the
+        // shared one), returning the one that was current
+    static Arena *SetCurrent(Arena *a);
+
+        // size bytes from the current arena, or else the shared one
+    static void *AllocateHere(size_t size);
+
+        // Prints the allocation count, bytes and blocks (debug key
+        // "arena"), with what as the heading
+    void PrintStats(const char *what);
+
+  protected:
+    struct Block {
+        Block *next;
+        size_t size;                // bytes after the header
+    };
+
+    Block *blocks;                  // the current block first
+    char *next, *end;               // the free part of the current block
+    size_t blockSize;               // of the next block
+    size_t numAllocations, bytesAllocated;
+    int numBlocks;
+
+    void *AllocateBlock(size_t size, bool current);
+
+    static thread_local Arena *current;
+};
+
+#endif
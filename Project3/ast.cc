@@ -6,28 +6,32 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
+#include "utility.h"  // IsDebugOn
 #include <string.h> // strdup
 #include <stdio.h>  // printf
 
-SymbolTable *Node::st = new SymbolTable();
-int Node::loopNum = 0;
-std::stack<Type *> *Node::returns = new std::stack<Type *>();
-std::stack<bool *> *Node::returned = new std::stack<bool *>();
+thread_local SymbolTable *Node::st = NULL;
+thread_local int Node::loopNum = 0;
+thread_local std::stack<Type *> *Node::returns = NULL;
+thread_local std::stack<bool *> *Node::returned = NULL;
 
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    location = loc;
     parent = NULL;
 }
 
 Node::Node() {
-    location = NULL;
+    location.line = 0;
+    location.offset = NoLocation;
+    location.length = 0;
     parent = NULL;
 }
 
 /* The Print method is used to print the parse tree nodes.
  * If this node has a location (most nodes do, but some do not), it
  * will first print the line number to help you match the parse tree 
- * back to the source text. It then indents the proper number of levels 
+ * back to the source text (and, with the debug key "locations", the
+ * byte offset and length too). It then indents the proper number of levels 
  * and prints the "print name" of the node. It then will invoke the
  * virtual function PrintChildren which is expected to print the
  * internals of the node (itself & children) as appropriate.
@@ -36,16 +40,22 @@ void Node::Print(int indentLevel, const char *label) {
     const int numSpaces = 3;
     printf("\n");
     if (GetLocation()) 
-        printf("%*d", numSpaces, GetLocation()->first_line);
+        printf("%*d", numSpaces, GetLocation()->line);
     else 
         printf("%*s", numSpaces, "");
+    if (IsDebugOn("locations")) {
+        if (GetLocation())
+            printf(" @%u+%u", GetLocation()->offset, GetLocation()->length);
+        else
+            printf(" @-");
+    }
     printf("%*s%s%s: ", indentLevel*numSpaces, "", 
            label? label : "", GetPrintNameForNode());
    PrintChildren(indentLevel);
 } 
 	 
-Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+Identifier::Identifier(yyltype loc, Atom n) : Node(loc) {
+    name = n;
 } 
 
 void Identifier::PrintChildren(int indentLevel) {
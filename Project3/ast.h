@@ -7,10 +7,12 @@
  * more correctly, of instances of concrete subclassses such as VarDecl,
  * ForStmt, and AssignExpr).
  * 
- * Location: Each node maintains its lexical location (line and columns in 
+ * Location: Each node maintains its lexical location (line and bytes in 
  * file), that location can be NULL for those nodes that don't care/use 
  * locations. The location is typcially set by the node constructor.  The 
  * location is used to provide the context when reporting semantic errors.
+ * It is kept in the node itself, not allocated on the side; a node with
+ * none has NoLocation as its offset, and GetLocation() gives NULL.
  *
  * Parent: Each node has a pointer to its parent. For a Program node, the 
  * parent is NULL, for all other nodes it is the pointer to the node one level
@@ -39,6 +41,8 @@
 
 #include <stdlib.h>   // for NULL
 #include "location.h"
+#include "atom.h"
+#include "arena.h"
 #include <iostream>
 #include <stack>
 
@@ -51,19 +55,28 @@ class Type;
 
 class Node  {
   protected:
-    yyltype *location;
     Node *parent;
-    static SymbolTable *st;
-    static int loopNum;
-    static stack<Type *> *returns;
-    static stack<bool *> *returned;
+    yyltype location;           // offset NoLocation if it has none
+    // semantic checker state, per thread so that concurrent compilations
+    // don't share it; Program::Check() starts each one afresh
+    static thread_local SymbolTable *st;
+    static thread_local int loopNum;
+    static thread_local stack<Type *> *returns;
+    static thread_local stack<bool *> *returned;
 
   public:
+    static const unsigned int NoLocation = ~0u;
+
     Node(yyltype loc);
     Node();
     virtual ~Node() {}
+
+    // Nodes live in the arena of the compilation that made them (see
+    // arena.h), and go when it does
+    static void *operator new(size_t size) { return Arena::AllocateHere(size); }
+    static void operator delete(void *p)   {}
     
-    yyltype *GetLocation()   { return location; }
+    yyltype *GetLocation()   { return location.offset == NoLocation? NULL : &location; }
     void SetParent(Node *p)  { parent = p; }
     Node *GetParent()        { return parent; }
 
@@ -81,12 +94,12 @@ class Node  {
 class Identifier : public Node 
 {
   protected:
-    char *name;
+    Atom name;
     
   public:
-    Identifier(yyltype loc, const char *name);
+    Identifier(yyltype loc, Atom name); // name must come from AtomTable
     const char *GetPrintNameForNode()   { return "Identifier"; }
-    char *GetName() const { return name; }
+    Atom GetName() const { return name; }
     void PrintChildren(int indentLevel);
     friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name; }
 };
@@ -77,7 +77,7 @@ void FnDecl::Check() {
     returns->push(this->GetType());
     returned->push(toPush);
 
-    StmtBlock *sb = dynamic_cast<StmtBlock *>(this->body);
+    StmtBlock *sb = dynamic_cast<StmtBlock *>(this->GetBody());
     sb->Check(new bool(true)); 
 
     if (!*(returned->top()))
@@ -94,21 +94,21 @@ Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     (id=n)->SetParent(this); 
 }
 
-VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
+VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n), assignTo(NULL) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
     if (e) (assignTo=e)->SetParent(this);
     typeq = NULL;
 }
 
-VarDecl::VarDecl(Identifier *n, TypeQualifier *tq, Expr *e) : Decl(n) {
+VarDecl::VarDecl(Identifier *n, TypeQualifier *tq, Expr *e) : Decl(n), assignTo(NULL) {
     Assert(n != NULL && tq != NULL);
     (typeq=tq)->SetParent(this);
     if (e) (assignTo=e)->SetParent(this);
     type = NULL;
 }
 
-VarDecl::VarDecl(Identifier *n, Type *t, TypeQualifier *tq, Expr *e) : Decl(n) {
+VarDecl::VarDecl(Identifier *n, Type *t, TypeQualifier *tq, Expr *e) : Decl(n), assignTo(NULL) {
     Assert(n != NULL && t != NULL && tq != NULL);
     (type=t)->SetParent(this);
     (typeq=tq)->SetParent(this);
@@ -142,10 +142,21 @@ void FnDecl::SetFunctionBody(Stmt *b) {
     (body=b)->SetParent(this);
 }
 
+Stmt *FnDecl::GetBody() {
+    LazyBody *lazy = dynamic_cast<LazyBody *>(body);
+    if (lazy && (body = lazy->Parse()) != NULL)
+        body->SetParent(this);
+    return body;
+}
+
+bool FnDecl::HasLazyBody() {
+    return dynamic_cast<LazyBody *>(body) != NULL;
+}
+
 void FnDecl::PrintChildren(int indentLevel) {
     if (returnType) returnType->Print(indentLevel+1, "(return type) ");
     if (id) id->Print(indentLevel+1);
     if (formals) formals->PrintAll(indentLevel+1, "(formals) ");
-    if (body) body->Print(indentLevel+1, "(body) ");
+    if (GetBody()) body->Print(indentLevel+1, "(body) ");
 }
 
@@ -78,6 +78,10 @@ class FnDecl : public Decl
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     FnDecl(Identifier *name, Type *returnType, TypeQualifier *returnTypeq, List<VarDecl*> *formals);
     void SetFunctionBody(Stmt *b);
+        // The body, parsed first if it was left for later (a LazyBody);
+        // NULL for a prototype, or if the body has a syntax error
+    Stmt *GetBody();
+    bool HasLazyBody();
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
 
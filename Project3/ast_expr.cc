@@ -230,7 +230,7 @@ Type * FieldAccess::typeCheck(bool *valid) {
     Type * left;
     if (base != NULL) {
         left = base->typeCheck(valid);
-        char * swizzle = field->GetName();
+        const char * swizzle = field->GetName();
         int swizzleLen = strlen(field->GetName());
 
         int v = 0;
@@ -331,6 +331,13 @@ void IntConstant::PrintChildren(int indentLevel) {
     printf("%d", value);
 }
 
+UintConstant::UintConstant(yyltype loc, unsigned int val) : Expr(loc) {
+    value = val;
+}
+void UintConstant::PrintChildren(int indentLevel) { 
+    printf("%u", value);
+}
+
 FloatConstant::FloatConstant(yyltype loc, double val) : Expr(loc) {
     value = val;
 }
@@ -388,6 +395,7 @@ CompoundExpr::CompoundExpr(Expr *l, Operator *o)
     Assert(l != NULL && o != NULL);
     (left=l)->SetParent(this);
     (op=o)->SetParent(this);
+    right = NULL;
 }
 
 void CompoundExpr::PrintChildren(int indentLevel) {
@@ -66,6 +66,22 @@ class IntConstant : public Expr
     }
 };
 
+class UintConstant : public Expr 
+{
+  protected:
+    unsigned int value;
+  
+  public:
+    UintConstant(yyltype loc, unsigned int val);
+    const char *GetPrintNameForNode() { return "UintConstant"; }
+    void PrintChildren(int indentLevel);
+
+    Type *typeCheck(bool *valid) {
+      printf("UintConstant typeCheck\n");
+      return new Type("uint");
+    }
+};
+
 class FloatConstant: public Expr 
 {
   protected:
@@ -9,7 +9,7 @@
 #include "errors.h"
 #include "symtable.h"
 
-Program::Program(List<Decl*> *d) {
+Program::Program(List<Decl*> *d) : start(NULL), globals(NULL) {
     Assert(d != NULL);
     (decls=d)->SetParentAll(this);
 }
@@ -28,6 +28,14 @@ void Program::Check() {
      *      and polymorphism in the node classes.
      */
 
+    // checker state is per thread; start this compilation with a clean
+    // slate, or with what the prelude declared
+    ReleaseGlobals();
+    st = start ? new SymbolTable(*start) : new SymbolTable();
+    loopNum = 0;
+    returns = new std::stack<Type *>();
+    returned = new std::stack<bool *>();
+
     // sample test - not the actual working code
     // replace it with your own implementation
     if ( decls->NumElements() > 0 ) {
@@ -40,6 +48,33 @@ void Program::Check() {
          d->Check();
       }
     }
+
+    // and free it, but for the global scope, which GetGlobals() gives
+    globals = st->takeGlobals();
+    delete st;
+    delete returns;
+    delete returned;
+    st = NULL;
+    returns = NULL;
+    returned = NULL;
+}
+
+bool Program::ParseLazyBodies() {
+    for (int i = 0; i < decls->NumElements(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl *>(decls->Nth(i));
+        if (fn && fn->HasLazyBody() && !fn->GetBody()) return false;
+    }
+    return true;
+}
+
+ScopedTable *Program::GetGlobals() {
+    Assert(globals != NULL);
+    return globals;
+}
+
+void Program::ReleaseGlobals() {
+    delete globals;
+    globals = NULL;
 }
 //--------------------------------------------------------------------------------------
 //own fns
@@ -231,6 +266,12 @@ StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
     (stmts=s)->SetParentAll(this);
 }
 
+LazyBody::LazyBody(yyltype text, SourceBuffer *s, Arena *a) : Stmt(text) {
+    Assert(s != NULL);
+    source = s;
+    arena = a;
+}
+
 void StmtBlock::PrintChildren(int indentLevel) {
     decls->PrintAll(indentLevel+1);
     stmts->PrintAll(indentLevel+1);
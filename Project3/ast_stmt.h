@@ -20,6 +20,9 @@ class Decl;
 class VarDecl;
 class Expr;
 class IntConstant;
+class ScopedTable;
+class SourceBuffer;
+class Arena;
   
 void yyerror(const char *msg);
 
@@ -27,12 +30,27 @@ class Program : public Node
 {
   protected:
      List<Decl*> *decls;
+     const ScopedTable *start;      // global scope to check from, or NULL
+     ScopedTable *globals;          // the global scope Check() left
      
   public:
      Program(List<Decl*> *declList);
      const char *GetPrintNameForNode() { return "Program"; }
      void PrintChildren(int indentLevel);
      void Check();
+
+         // Has Check() start from a copy of globals (a prelude's, see
+         // prelude.h) instead of an empty global scope
+     void StartFrom(const ScopedTable *globals) { start = globals; }
+         // The global scope as Check() left it, which the program keeps
+         // until ReleaseGlobals() or the next Check()
+     ScopedTable *GetGlobals();
+     void ReleaseGlobals();
+
+         // Parses the function bodies left for later (see LazyBody), in
+         // order, stopping at the first with a syntax error; returns
+         // whether they all parsed
+     bool ParseLazyBodies();
 };
 
 class Stmt : public Node
@@ -57,6 +75,26 @@ class StmtBlock : public Stmt
     void Check();
 };
 
+/* A function body not parsed yet (ParserSession::SetLazyBodies): its
+ * location is the whole of its text, braces and all. FnDecl::GetBody()
+ * has it parsed, into the arena the rest of the tree is in, the first
+ * time the body is wanted; the source has to be around until then.
+ */
+class LazyBody : public Stmt
+{
+  protected:
+    SourceBuffer *source;
+    Arena *arena;
+
+  public:
+    LazyBody(yyltype text, SourceBuffer *source, Arena *arena);
+    const char *GetPrintNameForNode() { return "LazyBody"; }
+
+        // The StmtBlock, or NULL after a syntax error (reported); it is
+        // in rdparse.cc, with the parser
+    Stmt *Parse();
+};
+
 class DeclStmt: public Stmt 
 {
   protected:
@@ -0,0 +1,37 @@
+#! /bin/sh
+#
+# Checks that the two parsers agree: compiles each sample with
+# -parser=bison and with -parser=rd, printing the tree with every
+# node's location (-d dumpAST locations), and compares the outputs,
+# which take in the checker's output and any errors as well. Names
+# every sample where they differ and exits non-zero if any did. The
+# argument, if any, is the directory of samples (../Project2/samples by
+# default); every .glsl file in it is compared. Any -option= before it
+# (a -lexer=, say) is passed on to glc.
+
+[ -x glc ] || { echo "Error: glc not executable"; exit 1; }
+
+OPTIONS=
+while [ "$#" != "0" ] && expr "x$1" : 'x-.*=' > /dev/null; do
+	OPTIONS="$OPTIONS $1"
+	shift
+done
+
+DIR=${1:-../Project2/samples}
+LIST=`ls $DIR/*.glsl` || exit 1
+
+BISON=`mktemp`
+RD=`mktemp`
+failed=0
+for file in $LIST; do
+	./glc $OPTIONS -parser=bison $file -d dumpAST locations > $BISON 2>&1
+	./glc $OPTIONS -parser=rd $file -d dumpAST locations > $RD 2>&1
+	if ! cmp -s $BISON $RD; then
+		echo "$file: the parsers differ"
+		diff $BISON $RD | head -20
+		failed=1
+	fi
+done
+rm -f $BISON $RD
+[ "$failed" = "0" ] && echo "The parsers agree on every sample"
+exit $failed
@@ -0,0 +1,98 @@
+/* File: atom.cc
+ * -------------
+ * Implementation of the atom table: an open-addressing hash set of
+ * spellings whose characters live in large chunks that are never freed
+ * or moved. A mutex guards the table since compilations on different
+ * threads intern into the same one.
+ */
+
+#include "atom.h"
+#include "utility.h"
+#include <string.h>
+#include <mutex>
+#include <vector>
+using std::vector;
+
+struct AtomSlot {
+    Atom text;                  // NULL if the slot is empty
+    unsigned int len, hash;
+};
+
+static const size_t ChunkSize = 64*1024;
+
+static std::mutex tableLock;
+static vector<AtomSlot> slots(1024);
+static size_t numAtoms = 0;
+static char *chunk = NULL;      // storage for new spellings
+static size_t chunkLeft = 0;
+static unsigned long numHits = 0, numMisses = 0, bytesInterned = 0;
+
+static unsigned int HashSpelling(const char *text, size_t len) {
+    unsigned int h = 2166136261u;       // FNV-1a
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)text[i]) * 16777619u;
+    return h;
+}
+
+static Atom StoreSpelling(const char *text, size_t len) {
+    if (chunkLeft < len + 1) {
+        size_t size = len + 1 > ChunkSize ? len + 1 : ChunkSize;
+        chunk = (char *)malloc(size);
+        if (!chunk) Failure("Out of memory interning identifiers");
+        chunkLeft = size;
+    }
+    char *copy = chunk;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    chunk += len + 1;
+    chunkLeft -= len + 1;
+    bytesInterned += len + 1;
+    return copy;
+}
+
+static void GrowTable() {
+    vector<AtomSlot> old(slots.size() * 2);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+        if (!old[i].text) continue;
+        size_t j = old[i].hash & mask;
+        while (slots[j].text) j = (j + 1) & mask;
+        slots[j] = old[i];
+    }
+}
+
+Atom AtomTable::Intern(const char *text, size_t len) {
+    unsigned int hash = HashSpelling(text, len);
+    std::lock_guard<std::mutex> guard(tableLock);
+
+    size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    for (; slots[i].text; i = (i + 1) & mask) {
+        if (slots[i].hash == hash && slots[i].len == len &&
+            memcmp(slots[i].text, text, len) == 0) {
+            numHits++;
+            return slots[i].text;
+        }
+    }
+
+    numMisses++;
+    AtomSlot &slot = slots[i];
+    slot.text = StoreSpelling(text, len);
+    slot.len = len;
+    slot.hash = hash;
+    Atom atom = slot.text;
+    if (++numAtoms * 2 > slots.size())
+        GrowTable();
+    return atom;
+}
+
+Atom AtomTable::Intern(const char *text) {
+    return Intern(text, strlen(text));
+}
+
+void AtomTable::PrintStats() {
+    std::lock_guard<std::mutex> guard(tableLock);
+    PrintDebug("atoms", "%lu atoms, %lu hits, %lu misses, %lu bytes interned",
+               (unsigned long)numAtoms, numHits, numMisses, bytesInterned);
+}
@@ -0,0 +1,34 @@
+/* File: atom.h
+ * ------------
+ * The atom table interns identifier spellings. The scanner interns each
+ * identifier as it is matched and hands the parser the resulting Atom: a
+ * pointer to the one stored copy of that spelling. Two Atoms are the same
+ * identifier exactly when the pointers are equal, so the AST and the
+ * symbol tables keep and compare Atoms instead of copying and strcmp'ing
+ * strings. Atoms are NUL-terminated and can be printed like any string.
+ *
+ * There is one table for the whole process, shared by every compilation
+ * (and thread), and stored spellings are never freed, so an Atom stays
+ * valid for the life of the program.
+ */
+
+#ifndef _H_atom
+#define _H_atom
+
+#include <stddef.h>
+
+typedef const char *Atom;
+
+class AtomTable
+{
+  public:
+        // Returns the atom for the first len characters of text, adding
+        // the spelling to the table if it was not there yet
+    static Atom Intern(const char *text, size_t len);
+    static Atom Intern(const char *text);
+
+        // Prints lookup hits/misses and bytes stored (debug key "atoms")
+    static void PrintStats();
+};
+
+#endif
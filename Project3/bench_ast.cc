@@ -0,0 +1,212 @@
+/* File: bench_ast.cc
+ * ------------------
+ * A benchmark for walking the AST, built with make bench_ast (make
+ * bench builds and runs it along with the lexer benchmark). It makes a
+ * synthetic program in memory, many functions with zero to three
+ * formals, a few local declarations, calls with zero to three
+ * arguments, and loops and branches around them. It then parses that
+ * program once and times Program::Check() over the tree. Check is the
+ * walk the compiler itself makes: Program::Check goes over the decls,
+ * StmtBlock::Check over the statements, and Call::typeCheck over the
+ * actuals and formals, which is where List access shows up. Each size
+ * gets one untimed pass, then timed passes (at least three, and as
+ * many as fit in a second); the best one is reported.
+ *
+ * The checker prints a line per node it visits; that output goes to
+ * /dev/null while the program runs, but is still formatted, so it is
+ * part of every number.
+ *
+ * A second table times the parse itself, with each parser (see
+ * -parser= and rdparse.h): the tokens are scanned once beforehand and
+ * each timed run parses a copy of them into a fresh session, which
+ * builds the tree but does not check it. The last column is the rd
+ * parser leaving the function bodies for later (see
+ * ParserSession::SetLazyBodies), which is what a caller that wants only
+ * the declarations would pay.
+ *
+ * Options: -max=<functions> to stop at a smaller program. As with
+ * bench_lexer, rebuild everything optimized for numbers worth
+ * comparing, e.g.
+ *     make clean; make bench_ast CFLAGS="-O2 -g -pthread"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "utility.h"
+#include "parser.h"
+#include "source.h"
+#include "arena.h"
+#include "tokens.h"
+
+/* A tiny deterministic generator, so every run checks the same tree */
+static unsigned int seed = 12345;
+static unsigned int Random(unsigned int n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static const int Sizes[] = { 100, 1000, 10000, 100000 };
+
+static void Call(std::string &s, int callee, int arity) {
+    s += "f" + std::to_string(callee) + "(";
+    for (int i = 0; i < arity; i++) {
+        if (i) s += ", ";
+        s += Random(2) ? "x" : "1.5";
+    }
+    s += ")";
+}
+
+/* Function i may call any earlier one, so arity[] says what each takes */
+static void Function(std::string &s, int i, std::vector<int> &arity) {
+    int formals = Random(4);
+    arity.push_back(formals);
+    s += "float f" + std::to_string(i) + "(";
+    for (int k = 0; k < formals; k++) {
+        if (k) s += ", ";
+        s += "float p" + std::to_string(k);
+    }
+    s += ") {\n    float x = 1.0;\n    float y = 2.0;\n";
+    for (int k = 0; k < formals; k++)
+        s += "    x = x + p" + std::to_string(k) + ";\n";
+    int statements = 2 + Random(6);
+    for (int k = 0; k < statements; k++) {
+        int callee = i ? Random(i) : -1;
+        switch (Random(4)) {
+          case 0:
+            s += "    y = y * x - 0.5;\n";
+            break;
+          case 1:
+            if (callee < 0) break;
+            s += "    y = ";
+            Call(s, callee, arity[callee]);
+            s += ";\n";
+            break;
+          case 2:
+            s += "    if (x > y) { x = x - 1.0; } else { y = y + 1.0; }\n";
+            break;
+          default:
+            s += "    while (x < 10.0) { x = x * 2.0; }\n";
+            break;
+        }
+    }
+    s += "    return x + y;\n}\n";
+}
+
+static void Generate(int functions, SourceBuffer *source) {
+    std::string text;
+    std::vector<int> arity;
+    seed = 12345;
+    for (int i = 0; i < functions; i++)
+        Function(text, i, arity);
+    text += "void main() {\n    float x = 0.5;\n    x = ";
+    Call(text, functions - 1, arity[functions - 1]);
+    text += ";\n}\n";
+    source->CopyText(text.data(), text.size());
+}
+
+/* The checker's printing goes to /dev/null between these */
+static int savedStdout = -1;
+
+static void Quiet() {
+    fflush(stdout);
+    savedStdout = dup(1);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    close(null);
+}
+
+static void Loud() {
+    fflush(stdout);
+    dup2(savedStdout, 1);
+    close(savedStdout);
+}
+
+static void Measure(int functions) {
+    typedef std::chrono::steady_clock Clock;
+    SourceBuffer source;
+    Generate(functions, &source);
+    ParserSession session(&source, L_Fast);
+    Quiet();
+    int errors = session.Parse();               // checks once: the warm up
+    Loud();
+    if (errors > 0 || !session.GetProgram()) Failure("The generated program has errors");
+    Program *program = session.GetProgram();
+
+    Arena scratch;                              // what Check() allocates
+    Arena *saved = Arena::SetCurrent(&scratch);
+    double best = 1e30, total = 0;
+    int runs = 0;
+    Quiet();
+    while (runs < 3 || (total < 1.0 && runs < 1000)) {
+        Clock::time_point start = Clock::now();
+        program->Check();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        total += seconds;
+        runs++;
+        if (seconds < best) best = seconds;
+    }
+    Loud();
+    Arena::SetCurrent(saved);
+    printf("%10d %11lu %5d %10.3f %10.1f\n", functions,
+           (unsigned long)source.GetLength(), runs, best * 1e3,
+           best / functions * 1e9);
+}
+
+/* The best time of at least three parses of tokens with parser, and as
+ * many as fit in a second
+ */
+static double TimeParse(SourceBuffer *source, const TokenBuffer &tokens,
+                        ParserKind parser, bool lazy = false) {
+    typedef std::chrono::steady_clock Clock;
+    double best = 1e30, total = 0;
+    int runs = 0;
+    while (runs < 3 || (total < 1.0 && runs < 1000)) {
+        ParserSession session(source, L_Fast);
+        session.SetParser(parser);
+        session.SetChecking(false);
+        session.SetLazyBodies(lazy);
+        session.SetTokens(new TokenBuffer(tokens));
+        Clock::time_point start = Clock::now();
+        int errors = session.Parse();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (errors > 0) Failure("The generated program has errors");
+        total += seconds;
+        runs++;
+        if (seconds < best) best = seconds;
+    }
+    return best;
+}
+
+static void MeasureParse(int functions) {
+    SourceBuffer source;
+    Generate(functions, &source);
+    ParserSession scan(&source, L_Fast);
+    scan.LexAhead();
+    const TokenBuffer *tokens = scan.GetTokens();
+    double bison = TimeParse(&source, *tokens, P_Bison);
+    double rd = TimeParse(&source, *tokens, P_RD);
+    double lazy = TimeParse(&source, *tokens, P_RD, true);
+    printf("%10d %9d %10.3f %10.3f %7.2fx %10.3f\n", functions, tokens->NumTokens(),
+           bison * 1e3, rd * 1e3, bison / rd, lazy * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    ParseCommandLine(argc, argv);
+    InitParser();
+    int max = GetOption("max") ? atoi(GetOption("max")) : Sizes[sizeof(Sizes)/sizeof(*Sizes) - 1];
+    printf("%10s %11s %5s %10s %10s\n", "functions", "bytes", "runs", "ms/check",
+           "ns/func");
+    for (int s = 0; s < sizeof(Sizes)/sizeof(*Sizes) && Sizes[s] <= max; s++)
+        Measure(Sizes[s]);
+    printf("\n%10s %9s %10s %10s %8s %10s\n", "functions", "tokens", "bison ms",
+           "rd ms", "speedup", "lazy ms");
+    for (int s = 0; s < sizeof(Sizes)/sizeof(*Sizes) && Sizes[s] <= max; s++)
+        MeasureParse(Sizes[s]);
+    return 0;
+}
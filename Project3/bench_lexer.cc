@@ -0,0 +1,247 @@
+/* File: bench_lexer.cc
+ * --------------------
+ * A throughput benchmark for the lexers, built with make bench_lexer
+ * (make bench builds and runs it). It makes synthetic corpora in
+ * memory, from 1 KB up to 1 GB, with different mixes of comments,
+ * identifiers and literals, and scans each with the flex scanner and
+ * with FastLexer. Each lexer gets one untimed pass over a corpus to
+ * warm up, then timed passes (at least three, and as many as fit in a
+ * second); the best one is reported as tokens/sec, bytes/sec and
+ * cycles/token. Tokens are only counted, not printed, so the numbers
+ * are the cost of scanning (atom interning included) and nothing else.
+ *
+ * Options: -lexer=flex|fast (default both), -corpus=<name> (default
+ * all) and -max=<size> to stop at a smaller corpus (K, M and G
+ * suffixes allowed). Cycles come from the time stamp counter, which
+ * counts at a fixed rate rather than the core clock, and are not
+ * available off x86.
+ *
+ * The numbers are only as good as the build: CFLAGS has no -O, so for
+ * figures worth comparing, rebuild everything optimized, e.g.
+ *     make clean; make bench_lexer CFLAGS="-O2 -g -pthread"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+#include "utility.h"
+#include "parser.h"
+#include "source.h"
+
+/* A tiny deterministic generator, so every run scans the same text */
+static unsigned int seed = 12345;
+static unsigned int Random(unsigned int n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static const char *Types[] = { "float", "int", "uint", "bool", "vec2", "vec3",
+                               "vec4", "mat4" };
+static const char *Names[] = { "color", "uv", "normal", "position", "i",
+                               "lightDirection", "worldViewProjection",
+                               "diffuseTexture_01", "x", "shadowBias" };
+static const char *Ops[] = { "+", "-", "*", "/", "<", "<=", "==", "&&", "||" };
+
+static void Name(std::string &s) {
+    s += Names[Random(sizeof(Names)/sizeof(*Names))];
+}
+
+static void Literal(std::string &s) {
+    char text[32];
+    switch (Random(5)) {
+      case 0: sprintf(text, "%u", Random(100000)); break;
+      case 1: sprintf(text, "0x%X", Random(1 << 24)); break;
+      case 2: sprintf(text, "%uu", Random(1000)); break;
+      case 3: sprintf(text, "%u.%u", Random(1000), Random(1000)); break;
+      default: sprintf(text, "%u.%uf", Random(100), Random(100)); break;
+    }
+    s += text;
+}
+
+/* One line of each corpus: a typical statement, a comment-heavy line,
+ * a run of long identifiers, and a list of numeric literals.
+ */
+static void MixedLine(std::string &s) {
+    s += "    ";
+    s += Types[Random(sizeof(Types)/sizeof(*Types))];
+    s += ' ';
+    Name(s);
+    s += " = ";
+    Name(s);
+    s += '.';
+    s += "xyzw"[Random(4)];
+    s += ' ';
+    s += Ops[Random(sizeof(Ops)/sizeof(*Ops))];
+    s += " (";
+    Literal(s);
+    s += ", ";
+    Name(s);
+    s += ");";
+    if (Random(4) == 0) s += "   // adjust for the light";
+    s += '\n';
+}
+
+static void CommentLine(std::string &s) {
+    if (Random(3) == 0)
+        s += "/* Multi-line commentary on the shading model used below,\n"
+             " * written the way shader authors tend to write it. */\n";
+    else
+        s += "// A line comment that goes on for a while about nothing much\n";
+    if (Random(2) == 0) MixedLine(s);
+}
+
+static void IdentifierLine(std::string &s) {
+    s += '\t';
+    for (int i = 0; i < 6; i++) {
+        Name(s);
+        s += "_with_a_longer_suffix";
+        s += (i < 5) ? ' ' : ';';
+    }
+    s += '\n';
+}
+
+static void LiteralLine(std::string &s) {
+    s += "  ";
+    for (int i = 0; i < 8; i++) {
+        Literal(s);
+        s += (i < 7) ? ", " : ";";
+    }
+    s += '\n';
+}
+
+struct Corpus {
+    const char *name;
+    void (*line)(std::string &s);
+};
+
+static const Corpus Corpora[] = {
+    { "mixed", MixedLine },
+    { "comments", CommentLine },
+    { "identifiers", IdentifierLine },
+    { "literals", LiteralLine },
+};
+
+static const size_t Sizes[] = { 1 << 10, 64 << 10, 1 << 20, 64 << 20, 1 << 30 };
+
+/* Whole lines up to size bytes (a partial line would end in the middle
+ * of a comment) */
+static void Generate(const Corpus &corpus, size_t size, SourceBuffer *source) {
+    std::string text;
+    text.reserve(size + 256);
+    seed = 12345;
+    size_t whole = 0;
+    while (text.size() <= size) {
+        whole = text.size();
+        corpus.line(text);
+    }
+    source->CopyText(text.data(), whole);
+}
+
+static unsigned long ScanFlex(SourceBuffer *source) {
+    yyscan_t scanner = InitScanner(source);
+    YYSTYPE lval;
+    yyltype loc;
+    unsigned long n = 0;
+    while (yylex(&lval, &loc, scanner)) n++;
+    FreeScanner(scanner);
+    return n;
+}
+
+static unsigned long ScanFast(SourceBuffer *source) {
+    FastLexer lexer(source);
+    YYSTYPE lval;
+    yyltype loc;
+    unsigned long n = 0;
+    while (lexer.NextToken(&lval, &loc)) n++;
+    return n;
+}
+
+static unsigned long long Cycles() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void Measure(const char *corpus, const char *lexer,
+                    unsigned long (*scan)(SourceBuffer *), SourceBuffer *source) {
+    typedef std::chrono::steady_clock Clock;
+    unsigned long tokens = scan(source);        // warm up
+    double best = 1e30, total = 0;
+    unsigned long long bestCycles = 0;
+    int runs = 0;
+    while (runs < 3 || (total < 1.0 && runs < 1000)) {
+        Clock::time_point start = Clock::now();
+        unsigned long long startCycles = Cycles();
+        if (scan(source) != tokens) Failure("Token count changed between runs");
+        unsigned long long cycles = Cycles() - startCycles;
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        total += seconds;
+        runs++;
+        if (seconds < best) {
+            best = seconds;
+            bestCycles = cycles;
+        }
+    }
+    printf("%-12s %11lu %-5s %10lu %5d %10.2f %9.1f", corpus,
+           (unsigned long)source->GetLength(), lexer, tokens, runs,
+           tokens / best / 1e6, source->GetLength() / best / 1e6);
+#ifdef HAVE_TSC
+    printf(" %10.1f\n", (double)bestCycles / tokens);
+#else
+    printf(" %10s\n", "n/a");
+#endif
+}
+
+/* Reads -max=, a byte count with an optional K, M or G suffix */
+static size_t MaxSize() {
+    const char *option = GetOption("max");
+    if (!option) return Sizes[sizeof(Sizes)/sizeof(*Sizes) - 1];
+    char *rest;
+    unsigned long long size = strtoull(option, &rest, 10);
+    switch (*rest) {
+      case 'K': case 'k': size <<= 10; rest++; break;
+      case 'M': case 'm': size <<= 20; rest++; break;
+      case 'G': case 'g': size <<= 30; rest++; break;
+    }
+    if (*rest || size == 0) {
+        printf("Bad -max size '%s'\n", option);
+        exit(2);
+    }
+    return size;
+}
+
+int main(int argc, char *argv[])
+{
+    ParseCommandLine(argc, argv);
+    size_t max = MaxSize();
+    const char *lexer = GetOption("lexer");
+    const char *only = GetOption("corpus");
+    if (lexer && strcmp(lexer, "flex") && strcmp(lexer, "fast")) {
+        printf("Unknown lexer '%s' (expected fast or flex)\n", lexer);
+        exit(2);
+    }
+
+    printf("%-12s %11s %-5s %10s %5s %10s %9s %10s\n", "corpus", "bytes",
+           "lexer", "tokens", "runs", "Mtokens/s", "MB/s", "cycles/tok");
+    for (int c = 0; c < sizeof(Corpora)/sizeof(*Corpora); c++) {
+        if (only && strcmp(only, Corpora[c].name)) continue;
+        for (int s = 0; s < sizeof(Sizes)/sizeof(*Sizes) && Sizes[s] <= max; s++) {
+            SourceBuffer source;
+            Generate(Corpora[c], Sizes[s], &source);
+            if (!lexer || !strcmp(lexer, "flex"))
+                Measure(Corpora[c].name, "flex", ScanFlex, &source);
+            if (!lexer || !strcmp(lexer, "fast"))
+                Measure(Corpora[c].name, "fast", ScanFast, &source);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/* File: charscan.h
+ * ----------------
+ * Character-class scanning for the lexers. Span<C>(p, end) returns how
+ * many characters starting at p belong to class C, looking at 32 (AVX2)
+ * or 16 (SSE2) characters at a time. AVX2 is used when the
+ * processor has it, which is checked once at run time; other machines
+ * fall back to SSE2, or to a plain loop off x86.
+ *
+ * Vector loads never reach past end, so the functions are safe on any
+ * buffer; the last few characters are done one at a time.
+ */
+
+#ifndef _H_charscan
+#define _H_charscan
+
+#include <stddef.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CHARSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+enum CharClass {
+    CC_Ident,       // [A-Za-z0-9_], the tail of an identifier
+    CC_Digit,       // [0-9]
+    CC_HexDigit,    // [0-9A-Fa-f]
+    CC_Space,       // ' ' and '\t' (a newline starts a line)
+    CC_CommentText  // anything but '*' and '\n', which a block comment
+                    // cannot simply step over
+};
+
+template<CharClass C> inline bool InClass(unsigned char ch) {
+    switch (C) {
+        case CC_Ident:    return (ch|0x20) - 'a' < 26u || ch - '0' < 10u || ch == '_';
+        case CC_Digit:    return ch - '0' < 10u;
+        case CC_HexDigit: return ch - '0' < 10u || (ch|0x20) - 'a' < 6u;
+        case CC_Space:    return ch == ' ' || ch == '\t';
+        case CC_CommentText: return ch != '*' && ch != '\n';
+    }
+    return false;
+}
+
+template<CharClass C> inline size_t SpanScalar(const char *p, const char *end) {
+    const char *start = p;
+    while (p < end && InClass<C>(*p)) p++;
+    return p - start;
+}
+
+#ifdef CHARSCAN_X86
+
+/* lo <= v <= hi, bytewise and unsigned */
+inline __m128i InRange128(__m128i v, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8(lo)), v),
+                         _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(hi)), v));
+}
+
+template<CharClass C> inline __m128i ClassMask128(__m128i v) {
+    __m128i digit = InRange128(v, '0', '9');
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    switch (C) {
+        case CC_Ident:
+            return _mm_or_si128(_mm_or_si128(digit, InRange128(lower, 'a', 'z')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        case CC_Digit:    return digit;
+        case CC_HexDigit: return _mm_or_si128(digit, InRange128(lower, 'a', 'f'));
+        case CC_Space:
+            return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+        case CC_CommentText:
+            return _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                                              _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                                 _mm_set1_epi8(-1));
+    }
+    return _mm_setzero_si128();
+}
+
+template<CharClass C> inline size_t SpanSSE2(const char *p, const char *end) {
+    const char *start = p;
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned int miss = ~_mm_movemask_epi8(ClassMask128<C>(v)) & 0xFFFF;
+        if (miss) return p - start + __builtin_ctz(miss);
+    }
+    return p - start + SpanScalar<C>(p, end);
+}
+
+__attribute__((target("avx2")))
+inline __m256i InRange256(__m256i v, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)), v),
+                            _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(hi)), v));
+}
+
+template<CharClass C> __attribute__((target("avx2")))
+inline __m256i ClassMask256(__m256i v) {
+    __m256i digit = InRange256(v, '0', '9');
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    switch (C) {
+        case CC_Ident:
+            return _mm256_or_si256(_mm256_or_si256(digit, InRange256(lower, 'a', 'z')),
+                                   _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        case CC_Digit:    return digit;
+        case CC_HexDigit: return _mm256_or_si256(digit, InRange256(lower, 'a', 'f'));
+        case CC_Space:
+            return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                   _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+        case CC_CommentText:
+            return _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                                    _mm256_set1_epi8(-1));
+    }
+    return _mm256_setzero_si256();
+}
+
+template<CharClass C> __attribute__((target("avx2")))
+inline size_t SpanAVX2(const char *p, const char *end) {
+    const char *start = p;
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned int miss = ~(unsigned int)_mm256_movemask_epi8(ClassMask256<C>(v));
+        if (miss) return p - start + __builtin_ctz(miss);
+    }
+    return p - start + SpanSSE2<C>(p, end);
+}
+
+inline bool HaveAVX2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+/* Function: Span
+ * --------------
+ * Returns the number of characters in [p, end) before the first one
+ * that is not in class C.
+ */
+template<CharClass C> inline size_t Span(const char *p, const char *end) {
+#ifdef CHARSCAN_X86
+    return HaveAVX2() ? SpanAVX2<C>(p, end) : SpanSSE2<C>(p, end);
+#else
+    return SpanScalar<C>(p, end);
+#endif
+}
+
+#endif
@@ -8,38 +8,64 @@
 #include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
+#include <mutex>
 
 using namespace std;
 
-#include "scanner.h" // for GetLineNumbered
+#include "scanner.h" // for GetLineNumbered, GetColumns
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
 
-int ReportError::numErrors = 0;
+thread_local int ReportError::numErrors = 0;
+thread_local vector<ReportError::Diagnostic> *ReportError::recording = NULL;
+static std::mutex outputLock;    // one message at a time, whatever the thread
 
 void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
-    if (!line) return;
+    int first, last;
+    if (!line || !GetColumns(pos, &first, &last)) return;
+    line = GetLineNumbered(pos->line);      // GetColumns() may have reused it
     cerr << line << endl;
-    for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
+    for (int i = 1; i <= last; i++)
+        cerr << (i >= first ? '^' : ' ');
     cerr << endl;
 }
 
  
  
-void ReportError::OutputError(yyltype *loc, string msg) {
+void ReportError::OutputError(yyltype *loc, string msg, yyltype *ref) {
+    if (recording) {
+        Diagnostic d;
+        d.located = (loc != NULL);
+        d.referenced = (ref != NULL);
+        if (loc) d.loc = *loc;
+        if (ref) d.ref = *ref;
+        d.msg = msg;
+        recording->push_back(d);
+    }
+    if (ref) {
+        size_t mark = msg.find(LineMark);
+        Assert(mark != string::npos);
+        msg.replace(mark, 1, to_string(ref->line));
+    }
+
+    std::lock_guard<std::mutex> lock(outputLock);
     numErrors++;
     fflush(stdout); // make sure any buffered text has been output
     if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+        cerr << endl << "*** Error line " << loc->line << "." << endl;
+        UnderlineErrorInLine(GetLineNumbered(loc->line), loc);
     } else
         cerr << endl << "*** Error." << endl;
     cerr << "*** " << msg << endl << endl;
 }
 
+void ReportError::Replay(Diagnostic *d) {
+    OutputError(d->located ? &d->loc : NULL, d->msg,
+                d->referenced ? &d->ref : NULL);
+}
+
 
 void ReportError::Formatted(yyltype *loc, const char *format, ...) {
     va_list args;
@@ -74,11 +100,17 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
     OutputError(loc, s.str());
 }
 
+void ReportError::ConstantOutOfRange(yyltype *loc, const char *text) {
+    ostringstream s;
+    s << "Numeric constant out of range: " << text;
+    OutputError(loc, s.str());
+}
+
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     ostringstream s;
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
-      << prevDecl->GetLocation()->first_line;
-    OutputError(decl->GetLocation(), s.str());
+      << LineMark;
+    OutputError(decl->GetLocation(), s.str(), prevDecl->GetLocation());
 }
 
 void ReportError::InvalidInitialization(Identifier *id, Type *lType, Type *rType) {
@@ -151,9 +183,9 @@ void ReportError::ReturnMismatch(ReturnStmt *rStmt, Type *given, Type *expected)
 void ReportError::ReturnMissing(FnDecl *fnDecl) {
     ostringstream s;
     s << "Declaration of '" << fnDecl << "' on line " 
-      << fnDecl->GetLocation()->first_line
+      << LineMark
       << " doesn't have a return";
-    OutputError(fnDecl->GetLocation(), s.str());
+    OutputError(fnDecl->GetLocation(), s.str(), fnDecl->GetLocation());
 }
 
 void ReportError::InaccessibleSwizzle(Identifier *field, Expr *base) {
@@ -197,12 +229,12 @@ void ReportError::ContinueOutsideLoop(ContinueStmt *cStmt) {
  * -------------------
  * Standard error-reporting function expected by yacc. Our version merely
  * just calls into the error reporter above, passing the location of
- * the last token read. If you want to suppress the ordinary "parse error"
- * message from yacc, you can implement yyerror to do nothing and
- * then call ReportError::Formatted yourself with a more descriptive 
- * message.
+ * the last token read by this thread's compilation. If you want to
+ * suppress the ordinary "parse error" message from yacc, you can
+ * implement yyerror to do nothing and then call ReportError::Formatted
+ * yourself with a more descriptive message.
  */
 
 void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+    ReportError::Formatted(GetLastLocation(), "%s", msg);
 }
@@ -14,6 +14,7 @@
 #define _errors_h_
 
 #include <string>
+#include <vector>
 #include "location.h"
 #include "ast_decl.h"
 
@@ -30,7 +31,7 @@ using namespace std;
  * the class name, e.g.
  *
  *    if (missingEnd) { 
- *       ReportError::UntermString(&yylloc, str);
+ *       ReportError::UntermString(yylloc, str);
  *    }
  *
  * For some methods, the first argument is the pointer to the location
@@ -64,6 +65,7 @@ class ReportError {
   static void LongIdentifier(yyltype *loc, const char *ident);
   static void UntermString(yyltype *loc, const char *str);
   static void UnrecogChar(yyltype *loc, char ch);
+  static void ConstantOutOfRange(yyltype *loc, const char *text);
 
   // Errors used by semantic analyzer for declarations
   static void DeclConflict(Decl *newDecl, Decl *prevDecl);
@@ -103,12 +105,39 @@ class ReportError {
   static void Formatted(yyltype *loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
+  // Returns number of error messages printed by this thread's compilation
   static int NumErrors() { return numErrors; }
+
+  // Starts the count over for a new compilation on this thread
+  static void Reset() { numErrors = 0; }
+
+  // Counts errors another thread printed for this thread's compilation
+  // (its scanner, with -tokens=thread)
+  static void AddErrors(int n) { numErrors += n; }
+
+  // An error as it was reported, kept so that it can be reported again
+  // for another input with the same tokens (see fingerprint.h). A
+  // message that names the line of some other location (ref) has
+  // LineMark where the number goes.
+  struct Diagnostic {
+    bool located, referenced;
+    yyltype loc, ref;
+    string msg;
+  };
+  static const char LineMark = '\1';
+
+  // Keeps a copy of every error this thread reports in into, until it
+  // is called again with NULL
+  static void Record(vector<Diagnostic> *into) { recording = into; }
+  static vector<Diagnostic> *Recording() { return recording; }
+
+  // Reports a recorded error again (with its locations moved, usually)
+  static void Replay(Diagnostic *d);
   
  private:
   static void UnderlineErrorInLine(const char *line, yyltype *pos);
-  static void OutputError(yyltype *loc, string msg);
-  static int numErrors;
+  static void OutputError(yyltype *loc, string msg, yyltype *ref = NULL);
+  static thread_local int numErrors;
+  static thread_local vector<Diagnostic> *recording;
 };
 #endif
@@ -0,0 +1,274 @@
+/* File: fastlex.cc
+ * ----------------
+ * Implementation of the hand-written lexer. The rules are those of
+ * scanner.l, applied the way flex applies them (longest match, the
+ * earlier rule on a tie); the comments name the flex rule a branch
+ * stands in for where that is not obvious.
+ */
+
+#include <string.h>
+#include "fastlex.h"
+#include "scanner.h"    // for MaxIdentLen
+#include "parser.h"     // for token codes, YYSTYPE
+#include "errors.h"
+#include "utility.h"
+#include "atom.h"
+#include "keywords.h"
+#include "charscan.h"
+
+static inline bool IsLetter(unsigned char ch) { return (ch|0x20) - 'a' < 26u; }
+static inline bool IsDigit(unsigned char ch)  { return ch - '0' < 10u; }
+
+FastLexer::FastLexer()
+{
+    scan.base = cur = end = NULL;
+    offsetBase = 0;
+    scan.length = 0;
+    state = Normal;
+    moreInput = false;
+    quiet = false;
+}
+
+FastLexer::FastLexer(SourceBuffer *source)
+{
+    PrintDebug("lex", "Initializing fast lexer over %lu bytes",
+               (unsigned long)source->GetLength());
+    scan.base = cur = source->GetBase();
+    scan.length = source->GetLength();
+    end = cur + scan.length;
+    offsetBase = 0;
+    state = Normal;
+    moreInput = false;
+    quiet = false;
+}
+
+/* Consumes len characters as one match, recording its location just as
+ * DoBeforeEachAction does for every flex match.
+ */
+inline void FastLexer::Advance(yyltype *loc, int len)
+{
+    loc->line = scan.curLineNum;
+    loc->offset = cur - scan.base + offsetBase;
+    loc->length = len;
+    cur += len;
+}
+
+void FastLexer::RestartAt(unsigned int offset, int line,
+                          const std::vector<unsigned int> &lineStarts)
+{
+    cur = scan.base + offset;
+    scan.curLineNum = line;
+    scan.lineStarts = lineStarts;
+    state = Normal;
+}
+
+void FastLexer::ScanRange(unsigned int offset, unsigned int length, int line)
+{
+    Assert(offset + length <= scan.length);
+    cur = scan.base + offset;
+    end = cur + length;
+    scan.curLineNum = line;
+    state = Normal;
+    quiet = true;
+}
+
+/* Skips the rest of a block comment from cur. Running out of input
+ * first is an unterminated comment, unless more input is coming, in
+ * which case the lexer waits for it in the Comment state. Returns
+ * whether the comment ended.
+ */
+bool FastLexer::SkipComment()
+{
+    const char *p = scan.SkipBlockComment(cur);
+    if (p) {
+        cur = p;
+        state = Normal;
+        return true;
+    }
+    cur = end;
+    if (moreInput) {
+        state = Comment;
+        return false;
+    }
+    state = Normal;
+    if (!quiet) ReportError::UntermComment();
+    return false;
+}
+
+int FastLexer::NextToken(YYSTYPE *lval, yyltype *loc)
+{
+    if (state == Comment && !SkipComment()) return 0;
+    while (cur < end) {
+        unsigned char ch = *cur;
+        if (ch == ' ' || ch == '\n' || ch == '\t') {
+            cur = scan.SkipWhitespace(cur);
+            continue;
+        }
+
+        if (state == Fields) {
+            if (IsLetter(ch)) return FieldSelection(lval, loc);
+            if (ch != '\r' && !quiet)           // flex's default rule: ECHO
+                fwrite(cur, 1, 1, stdout);
+            Advance(loc, 1);
+            continue;
+        }
+
+        // The source is followed by NUL padding, so peeking at cur[1]
+        // is safe; a NUL there matches none of the two-character tokens.
+        char next = cur[1];
+        switch (ch) {
+          case '(': Advance(loc, 1); return T_LeftParen;
+          case ')': Advance(loc, 1); return T_RightParen;
+          case ':': Advance(loc, 1); return T_Colon;
+          case ';': Advance(loc, 1); return T_Semicolon;
+          case '{': Advance(loc, 1); return T_LeftBrace;
+          case '}': Advance(loc, 1); return T_RightBrace;
+          case '[': Advance(loc, 1); return T_LeftBracket;
+          case ']': Advance(loc, 1); return T_RightBracket;
+          case ',': Advance(loc, 1); return T_Comma;
+          case '#':
+            if (scan.AtLineStart(cur)) return Directive(lval, loc);
+            break;
+          case '.': Advance(loc, 1); state = Fields; return T_Dot;
+
+          case '/':
+            if (next == '*') {
+                Advance(loc, 2);
+                if (!SkipComment()) return 0;
+                continue;
+            }
+            if (next == '/') {
+                Advance(loc, 2);
+                cur = scan.SkipLineComment(cur);
+                continue;
+            }
+            if (next == '=') return Operator(lval, loc, 2, T_DivAssign);
+            return Operator(lval, loc, 1, T_Slash);
+          case '<':
+            if (next == '=') return Operator(lval, loc, 2, T_LessEqual);
+            return Operator(lval, loc, 1, T_LeftAngle);
+          case '>':
+            if (next == '=') return Operator(lval, loc, 2, T_GreaterEqual);
+            return Operator(lval, loc, 1, T_RightAngle);
+          case '=':
+            if (next == '=') return Operator(lval, loc, 2, T_EQ);
+            return Operator(lval, loc, 1, T_Equal);
+          case '+':
+            if (next == '+') return Operator(lval, loc, 2, T_Inc);
+            if (next == '=') return Operator(lval, loc, 2, T_AddAssign);
+            return Operator(lval, loc, 1, T_Plus);
+          case '-':
+            if (next == '-') return Operator(lval, loc, 2, T_Dec);
+            if (next == '=') return Operator(lval, loc, 2, T_SubAssign);
+            return Operator(lval, loc, 1, T_Dash);
+          case '*':
+            if (next == '=') return Operator(lval, loc, 2, T_MulAssign);
+            return Operator(lval, loc, 1, T_Star);
+          case '?': return Operator(lval, loc, 1, T_Question);
+          case '!':
+            if (next == '=') return Operator(lval, loc, 2, T_NE);
+            break;
+          case '&':
+            if (next == '&') return Operator(lval, loc, 2, T_And);
+            break;
+          case '|':
+            if (next == '|') return Operator(lval, loc, 2, T_Or);
+            break;
+
+          default:
+            if (IsLetter(ch)) return Identifier(lval, loc);
+            if (IsDigit(ch)) return Number(lval, loc);
+            break;
+        }
+
+        Advance(loc, 1);                        // the default rule (error)
+        if (!quiet) ReportError::UnrecogChar(loc, ch);
+    }
+    return 0;
+}
+
+int FastLexer::Operator(YYSTYPE *lval, yyltype *loc, int len, int token)
+{
+    lval->identifier = AtomTable::Intern(cur, len);
+    Advance(loc, len);
+    return token;
+}
+
+/* "#" first on its line: a preprocessor directive */
+int FastLexer::Directive(YYSTYPE *lval, yyltype *loc)
+{
+    Advance(loc, 1);
+    cur = scan.SkipDirective(cur);
+    lval->identifier = AtomTable::Intern(scan.directiveText.c_str());
+    return T_Directive;
+}
+
+/* {IDENTIFIER}, including the keywords it picks out */
+int FastLexer::Identifier(YYSTYPE *lval, yyltype *loc)
+{
+    const char *text = cur;
+    int len = 1 + Span<CC_Ident>(cur + 1, end);
+    Advance(loc, len);
+
+    int keyword = LookupKeyword(text, len);
+    if (keyword == T_BoolConstant)
+        lval->boolConstant = (text[0] == 't');
+    if (keyword)
+        return keyword;
+    if (len > 1023 && !quiet)
+        ReportError::LongIdentifier(loc, std::string(text, len).c_str());
+    lval->identifier = AtomTable::Intern(text, len > MaxIdentLen ? MaxIdentLen : len);
+    return T_Identifier;
+}
+
+/* <FIELDS>{IDENTIFIER} */
+int FastLexer::FieldSelection(YYSTYPE *lval, yyltype *loc)
+{
+    const char *text = cur;
+    int len = 1 + Span<CC_Ident>(cur + 1, end);
+    Advance(loc, len);
+    state = Normal;
+
+    if (len > 1023 && !quiet)
+        ReportError::LongIdentifier(loc, std::string(text, len).c_str());
+    lval->identifier = AtomTable::Intern(text, len > MaxIdentLen ? MaxIdentLen : len);
+    return T_FieldSelection;
+}
+
+/* {HEX_INTEGER}, {INTEGER} or {FLOAT}, each integer form with or
+ * without the [uU] suffix, whichever matches the longest
+ */
+int FastLexer::Number(YYSTYPE *lval, yyltype *loc)
+{
+    const char *text = cur;
+    int len, base = 10;
+    if (text[0] == '0' && (text[1]|0x20) == 'x' && end - text > 2 &&
+        InClass<CC_HexDigit>(text[2])) {
+        len = 2 + Span<CC_HexDigit>(text + 2, end);
+        base = 16;
+    } else {
+        len = Span<CC_Digit>(text, end);
+        if (text + len < end && text[len] == '.') {
+            len += 1 + Span<CC_Digit>(text + len + 1, end);
+            if (text + len < end && (text[len]|0x20) == 'f')
+                len++;
+            Advance(loc, len);
+            lval->floatConstant = ScanFloat(text, len, quiet ? NULL : loc);
+            return T_FloatConstant;
+        }
+    }
+
+    if (text + len < end && (text[len]|0x20) == 'u') {
+        Advance(loc, len + 1);
+        lval->uintConstant = ScanInteger(text, len, base, quiet ? NULL : loc);
+        return T_UintConstant;
+    }
+    Advance(loc, len);
+    lval->integerConstant = ScanInteger(text, len, base, quiet ? NULL : loc);
+    return T_IntConstant;
+}
+
+const char *FastLexer::GetLineNumbered(int num)
+{
+    return scan.GetLine(num);
+}
@@ -0,0 +1,80 @@
+/* File: fastlex.h
+ * ---------------
+ * A hand-written lexer for the same language as scanner.l. It is used
+ * when the compiler runs with -lexer=fast, and alongside the flex
+ * scanner with -lexer=diff, which checks that the two agree token for
+ * token.
+ *
+ * FastLexer must behave exactly like the flex scanner: the same token
+ * codes, the same yylval fields, the same yylloc (line, byte offset and
+ * length) and the same diagnostics, in the same order. The
+ * difference is that runs of identifier characters and digits are
+ * measured with the vector routines in charscan.h instead of a DFA step
+ * per character; whitespace and comments are skipped by the same
+ * ScannerState methods the flex scanner uses. Any change to the rules
+ * in scanner.l has to be made here too; -lexer=diff is there to catch
+ * the ones that weren't.
+ */
+
+#ifndef _H_fastlex
+#define _H_fastlex
+
+#include <string>
+#include <vector>
+#include "location.h"
+#include "source.h"
+#include "scanner.h"
+
+union YYSTYPE;
+
+class FastLexer
+{
+  protected:
+    enum LexState { Normal, Fields,     // the flex N/INITIAL and FIELDS states
+                    Comment };          // in a /* comment when the input ran out
+
+    ScannerState scan;                  // line counter, line index
+    const char *cur, *end;              // the scan position and the end
+    unsigned int offsetBase;            // offset in the input of scan.base
+    LexState state;
+    bool moreInput;                     // end is only the end of a chunk
+    bool quiet;                         // scanning again: no errors, no echo
+
+    FastLexer();                        // no input yet (for StreamLexer)
+    bool SkipComment();
+    void Advance(yyltype *loc, int len);
+    int Directive(YYSTYPE *lval, yyltype *loc);
+    int Identifier(YYSTYPE *lval, yyltype *loc);
+    int FieldSelection(YYSTYPE *lval, yyltype *loc);
+    int Number(YYSTYPE *lval, yyltype *loc);
+    int Operator(YYSTYPE *lval, yyltype *loc, int len, int token);
+
+  public:
+    FastLexer(SourceBuffer *source);    // source must outlive the lexer
+
+        // Scans the next token, filling in lval and loc the way yylex
+        // would. Returns the token code, or 0 at end of input.
+    int NextToken(YYSTYPE *lval, yyltype *loc);
+
+        // The text of line n, or NULL if there is no such line (yet)
+    const char *GetLineNumbered(int n);
+
+        // Carries on scanning from offset as though the scan had just
+        // got there, on the given line and in the normal (not field
+        // selection) state. lineStarts holds the start of every line up
+        // to that one.
+    void RestartAt(unsigned int offset, int line,
+                   const std::vector<unsigned int> &lineStarts);
+
+        // Scans only the length bytes from offset, which is on the given
+        // line, and then ends the input (for a function body parsed
+        // later, see LazyBody). Locations are the source's; the line
+        // index is not kept, so line text has to come from elsewhere.
+        // The text has been scanned before, so what was reported or
+        // echoed then is not again.
+    void ScanRange(unsigned int offset, unsigned int length, int line);
+
+    ScannerState *GetState()        { return &scan; }
+};
+
+#endif
@@ -0,0 +1,81 @@
+/* File: fingerprint.cc
+ * --------------------
+ * Implementation of token stream fingerprints. Tokens are in source
+ * order, so both their start offsets and their end offsets are sorted,
+ * and Remap() finds a position among them by binary search.
+ */
+
+#include <string.h>
+#include <string>
+#include "fingerprint.h"
+#include "parser.h"
+
+uint64_t Fingerprint::Of(const TokenBuffer *tokens) {
+    uint64_t h = HashStart;
+    for (int i = 0; i < tokens->NumTokens(); i++) {
+        unsigned short kind = tokens->kinds[i];
+        h = HashText((const char *)&kind, sizeof(kind), h);
+        if (tokens->values[i] == TokenBuffer::NoValue) continue;
+        const TokenValue &value = tokens->valueTable[tokens->values[i]];
+        switch (ValueKindOf(kind)) {
+          case V_None:
+            break;
+          case V_Integer: case V_Uint:
+            h = HashText((const char *)&value.uintConstant, sizeof(unsigned int), h);
+            break;
+          case V_Float:
+            h = HashText((const char *)&value.floatConstant, sizeof(double), h);
+            break;
+          case V_Bool:
+            h = HashText(value.boolConstant ? "1" : "0", 1, h);
+            break;
+          case V_Atom:      // the spelling, with its NUL to end it
+            h = HashText(value.identifier, strlen(value.identifier) + 1, h);
+            break;
+        }
+    }
+    return h;
+}
+
+uint64_t Fingerprint::BatchKey(const TokenBuffer *tokens, const char *path) {
+    uint64_t h = Of(tokens);
+    bool directives = false;
+    for (int i = 0; i < tokens->NumTokens() && !directives; i++)
+        directives = (tokens->kinds[i] == T_Directive);
+    if (!directives) return h;
+    std::string dir(path ? path : "");
+    size_t slash = dir.rfind('/');
+    dir = (slash == std::string::npos) ? "." : dir.substr(0, slash);
+    return HashText(dir.data(), dir.size(), h);
+}
+
+/* Returns the token of t that starts (or, with ends, ends) at offset,
+ * or -1 if there is none. The end of input token is left out.
+ */
+static int FindToken(const TokenBuffer *t, unsigned int offset, bool ends) {
+    int lo = 0, hi = t->NumTokens() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        unsigned int at = t->offsets[mid] + (ends ? t->lengths[mid] : 0);
+        if (at < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == t->NumTokens() - 1) return -1;
+    unsigned int at = t->offsets[lo] + (ends ? t->lengths[lo] : 0);
+    return at == offset ? lo : -1;
+}
+
+/* The start is moved together with the line, which goes with it. A
+ * location whose end is not the end of a token keeps its length.
+ */
+void Fingerprint::Remap(yyltype *loc, const TokenBuffer *from, const TokenBuffer *to) {
+    int first = FindToken(from, loc->offset, false);
+    if (first < 0) return;
+    int last = FindToken(from, loc->offset + loc->length, true);
+    loc->offset = to->offsets[first];
+    loc->line = to->lines[first];
+    if (last >= first)
+        loc->length = to->offsets[last] + to->lengths[last] - loc->offset;
+}
@@ -0,0 +1,42 @@
+/* File: fingerprint.h
+ * -------------------
+ * A fingerprint is a hash of a token stream as the parser would see
+ * it: the kind of each token and its value (an identifier's spelling,
+ * a constant's value, a directive's text), but not where it is. Two
+ * sources that differ only in whitespace and comments have the same
+ * fingerprint, so compiling one tells everything about compiling the
+ * other, except where in its own text each error is.
+ *
+ * glc prints fingerprints with -fingerprint=print (or, without
+ * compiling anything, -fingerprint=only), for a build cache to key on.
+ * The fingerprint covers the file's own tokens only, not the files it
+ * #includes, and it is only meaningful for a source that scanned
+ * without errors (a character the scanner rejects makes no token).
+ */
+
+#ifndef _H_fingerprint
+#define _H_fingerprint
+
+#include <stdint.h>
+#include "tokens.h"
+
+class Fingerprint
+{
+  public:
+        // The fingerprint of tokens
+    static uint64_t Of(const TokenBuffer *tokens);
+
+        // What inputs in one batch compare to share a compilation: the
+        // fingerprint, and if the tokens include a directive, the
+        // directory of path as well, since an #include "x" is looked
+        // for there
+    static uint64_t BatchKey(const TokenBuffer *tokens, const char *path);
+
+        // Moves loc from a place in the tokens of from to the same place
+        // in the tokens of to, which has the same fingerprint. Positions
+        // that are not the start or end of a token of from are left as
+        // they are.
+    static void Remap(yyltype *loc, const TokenBuffer *from, const TokenBuffer *to);
+};
+
+#endif
@@ -0,0 +1,137 @@
+/* File: keywords.h
+ * ----------------
+ * Keyword recognition for the scanner. Rather than spelling out one flex
+ * rule per keyword, the scanner matches keywords and identifiers with
+ * the single IDENTIFIER rule and then asks LookupKeyword() whether the
+ * lexeme is a keyword. What this does to the size of the generated
+ * tables and to scanning speed has not been measured; make bench_lexer
+ * with -lexer=flex, before and after, is where to get the numbers.
+ *
+ * LookupKeyword() uses a perfect hash: the table below is laid out at
+ * compile time with a hash seed for which no two keywords land in the
+ * same slot, so a lookup is one hash, one probe and one memcmp.
+ *
+ * To add a keyword, add a line to the keywords array; the seed, the
+ * table and the length bounds are recomputed by the compiler. If no
+ * seed can be found the static_assert below fires and KeywordTableSize
+ * has to grow.
+ */
+
+#ifndef _H_keywords
+#define _H_keywords
+
+#include <string.h>
+#include "parser.h"   // for the token codes
+
+struct Keyword {
+    const char *spelling;
+    int token;
+};
+
+static constexpr Keyword keywords[] = {
+    {"void",     T_Void},     {"int",      T_Int},      {"float",    T_Float},
+    {"bool",     T_Bool},     {"while",    T_While},    {"for",      T_For},
+    {"if",       T_If},       {"else",     T_Else},     {"return",   T_Return},
+    {"break",    T_Break},    {"switch",   T_Switch},   {"case",     T_Case},
+    {"default",  T_Default},  {"const",    T_Const},    {"uniform",  T_Uniform},
+    {"continue", T_Continue}, {"do",       T_Do},       {"in",       T_In},
+    {"out",      T_Out},      {"mat2",     T_Mat2},     {"mat3",     T_Mat3},
+    {"mat4",     T_Mat4},     {"vec2",     T_Vec2},     {"vec3",     T_Vec3},
+    {"vec4",     T_Vec4},     {"ivec2",    T_Ivec2},    {"ivec3",    T_Ivec3},
+    {"ivec4",    T_Ivec4},    {"bvec2",    T_Bvec2},    {"bvec3",    T_Bvec3},
+    {"bvec4",    T_Bvec4},    {"uint",     T_Uint},     {"uvec2",    T_Uvec2},
+    {"uvec3",    T_Uvec3},    {"uvec4",    T_Uvec4},
+    {"true",     T_BoolConstant}, {"false", T_BoolConstant},
+};
+
+static constexpr int NumKeywords = sizeof(keywords) / sizeof(keywords[0]);
+static constexpr int KeywordTableSize = 128;   // power of two
+
+constexpr size_t KeywordLength(const char *s) {
+    size_t n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+/* The length of the shortest keyword, or of the longest */
+constexpr size_t KeywordLengthBound(bool longest) {
+    size_t bound = KeywordLength(keywords[0].spelling);
+    for (int i = 1; i < NumKeywords; i++) {
+        size_t len = KeywordLength(keywords[i].spelling);
+        if (longest ? len > bound : len < bound) bound = len;
+    }
+    return bound;
+}
+
+static constexpr size_t MinKeywordLen = KeywordLengthBound(false);
+static constexpr size_t MaxKeywordLen = KeywordLengthBound(true);
+static_assert(MaxKeywordLen <= 255, "KeywordSlot::length is a byte");
+
+constexpr unsigned int KeywordHash(unsigned int seed, const char *s, size_t len) {
+    unsigned int h = seed;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return (h ^ (h >> 16)) & (KeywordTableSize - 1);
+}
+
+/* Tries seeds in turn until every keyword hashes to a slot of its own.
+ * Returns 0 if none of them works.
+ */
+constexpr unsigned int FindKeywordSeed() {
+    for (unsigned int seed = 1; seed < 100000; seed++) {
+        bool used[KeywordTableSize] = {};
+        bool ok = true;
+        for (int i = 0; ok && i < NumKeywords; i++) {
+            const char *s = keywords[i].spelling;
+            unsigned int slot = KeywordHash(seed, s, KeywordLength(s));
+            ok = !used[slot];
+            used[slot] = true;
+        }
+        if (ok) return seed;
+    }
+    return 0;
+}
+
+static constexpr unsigned int KeywordSeed = FindKeywordSeed();
+static_assert(KeywordSeed != 0, "no perfect hash seed for the keyword table");
+
+struct KeywordSlot {
+    const char *spelling;   // NULL if the slot is empty
+    unsigned char length;
+    int token;
+};
+
+struct KeywordTable {
+    KeywordSlot slots[KeywordTableSize];
+};
+
+constexpr KeywordTable BuildKeywordTable() {
+    KeywordTable table = {};
+    for (int i = 0; i < NumKeywords; i++) {
+        const char *s = keywords[i].spelling;
+        size_t len = KeywordLength(s);
+        KeywordSlot &slot = table.slots[KeywordHash(KeywordSeed, s, len)];
+        slot.spelling = s;
+        slot.length = len;
+        slot.token = keywords[i].token;
+    }
+    return table;
+}
+
+static constexpr KeywordTable keywordTable = BuildKeywordTable();
+
+/* Function: LookupKeyword
+ * -----------------------
+ * Returns the token code for the keyword spelled by the first len
+ * characters of text, or 0 if they do not spell a keyword. Note that
+ * "true" and "false" come back as T_BoolConstant.
+ */
+inline int LookupKeyword(const char *text, size_t len) {
+    if (len < MinKeywordLen || len > MaxKeywordLen) return 0;
+    const KeywordSlot &slot = keywordTable.slots[KeywordHash(KeywordSeed, text, len)];
+    if (slot.length == len && memcmp(slot.spelling, text, len) == 0)
+        return slot.token;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#! /bin/sh
+#
+# Checks that the two lexers agree: scans each sample with -lexer=diff,
+# which runs the flex scanner and the hand-written lexer side by side
+# and stops at the first token they disagree on, in each -tokens= mode,
+# then compiles it with -lexer=flex and with -lexer=fast and compares
+# the outputs. Names every sample where they differ and exits non-zero
+# if any did. The argument, if any, is the directory of samples
+# (../Project2/samples by default); every .glsl file in it is checked.
+
+[ -x glc ] || { echo "Error: glc not executable"; exit 1; }
+
+DIR=${1:-../Project2/samples}
+LIST=`ls $DIR/*.glsl` || exit 1
+
+FLEX=`mktemp`
+FAST=`mktemp`
+failed=0
+for file in $LIST; do
+	for mode in pull buffer thread; do
+		./glc -lexer=diff -tokens=$mode $file > $FLEX 2>&1
+		if grep -q '^\*\*\* Failure' $FLEX; then
+			echo "$file: the lexers differ (-tokens=$mode)"
+			grep '^\*\*\* Failure' $FLEX
+			failed=1
+		fi
+	done
+	./glc -lexer=flex $file > $FLEX 2>&1
+	./glc -lexer=fast $file > $FAST 2>&1
+	if ! cmp -s $FLEX $FAST; then
+		echo "$file: the outputs differ"
+		diff $FLEX $FAST | head -20
+		failed=1
+	fi
+done
+rm -f $FLEX $FAST
+[ "$failed" = "0" ] && echo "The lexers agree on every sample"
+exit $failed
@@ -3,11 +3,19 @@
  * ------------
  * Simple list class for storing a linear collection of elements. It
  * supports operations similar in name to the CS107 CVector -- nth, insert,
- * append, remove, etc.  This class is nothing more than a very thin
- * cover of a STL deque, with some added range-checking. Given not everyone
+ * append, remove, etc., with some added range-checking. Given not everyone
  * is familiar with the C++ templates, this class provides a more familiar
  * interface.
  *
+ * The elements are kept in one contiguous array, so Nth() is a plain
+ * index and a walk over a list reads memory in order. The first
+ * InlineCapacity elements are stored in the List itself: most formal
+ * and argument lists are shorter than that and never allocate. Past
+ * that the array doubles as the list grows. Lists are part of the AST,
+ * so a List and its array are allocated from the current arena (see
+ * arena.h), like nodes, and go with it; the memory of an array that
+ * has been outgrown is not reused.
+ *
  * It can handle elements of any type, the typename for a List includes the
  * element type in angle brackets, e.g.  to store elements of type double,
  * you would use the type name List<double>, to store elements of type
@@ -28,7 +36,8 @@
 #ifndef _H_list
 #define _H_list
 
-#include <deque>
+#include <new>
+#include "arena.h"
 #include "utility.h"  // for Assert()
 using namespace std;
 
@@ -36,16 +45,39 @@ class Node;
 
 template<class Element> class List {
 
+ public:
+    static const int InlineCapacity = 4;
+
  private:
-    deque<Element> elems;
+    Element *elems;             // inlineElems until the list outgrows it
+    int count, capacity;
+    alignas(Element) unsigned char inlineElems[InlineCapacity * sizeof(Element)];
+
+    void Grow()
+        { static_assert(alignof(Element) <= Arena::Align, "arena alignment");
+          Element *bigger = (Element *)Arena::AllocateHere(2 * capacity * sizeof(Element));
+          for (int i = 0; i < count; i++) {
+              new (bigger + i) Element(elems[i]);
+              elems[i].~Element();
+          }
+          elems = bigger;
+          capacity *= 2; }
+
+    List(const List &);                 // not copied
+    List &operator=(const List &);
 
  public:
            // Create a new empty list
-    List() {}
+    List() : elems((Element *)inlineElems), count(0), capacity(InlineCapacity) {}
+    ~List()
+        { for (int i = 0; i < count; i++) elems[i].~Element(); }
+
+    static void *operator new(size_t size) { return Arena::AllocateHere(size); }
+    static void operator delete(void *p)   {}
 
            // Returns count of elements currently in list
     int NumElements() const
-	{ return elems.size(); }
+	{ return count; }
 
           // Returns element at index in list. Indexing is 0-based.
           // Raises an assert if index is out of range.
@@ -57,17 +89,27 @@ template<class Element> class List {
           // Raises assert if index out of range
     void InsertAt(const Element &elem, int index)
 	{ Assert(index >= 0 && index <= NumElements());
-	  elems.insert(elems.begin() + index, elem); }
+	  if (index == count) { Append(elem); return; }
+	  Element copy(elem);           // elem may be in the list
+	  Append(elems[count - 1]);
+	  for (int i = count - 2; i > index; i--) elems[i] = elems[i - 1];
+	  elems[index] = copy; }
 
           // Adds element to list end
     void Append(const Element &elem)
-	{ elems.push_back(elem); }
+	{ if (count == capacity) {
+	      Element copy(elem);       // elem may be in the list
+	      Grow();
+	      new (elems + count++) Element(copy);
+	  } else
+	      new (elems + count++) Element(elem); }
 
          // Removes element at index, shuffling down others
          // Raises assert if index out of range
     void RemoveAt(int index)
 	{ Assert(index >= 0 && index < NumElements());
-	  elems.erase(elems.begin() + index); }
+	  for (int i = index; i < count - 1; i++) elems[i] = elems[i + 1];
+	  elems[--count].~Element(); }
           
        // These are some specific methods useful for lists of ast nodes
        // They will only work on lists of elements that respond to the
@@ -85,4 +127,3 @@ template<class Element> class List {
 };
 
 #endif
-
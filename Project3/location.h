@@ -2,9 +2,10 @@
  * ----------------
  * This file just contains features relative to the location structure
  * used to record the lexical position of a token or symbol.  This file
- * establishes the cmoon definition for the yyltype structure, the global
- * variable yylloc, and a utility function to join locations you might
- * find handy at times.
+ * establishes the cmoon definition for the yyltype structure and a
+ * utility function to join locations you might find handy at times.
+ * There is no global yylloc: the pure parser owns the location of the
+ * lexeme just scanned and hands the scanner a pointer to it.
  */
 
 #ifndef YYLTYPE
@@ -12,26 +13,25 @@
 /* Typedef: yyltype
  * ----------------
  * Defines the struct type that is used by the scanner to store
- * position information about each lexeme scanned.
+ * position information about each lexeme scanned: where it starts in
+ * the source, as a byte offset, how many bytes it spans, and the line
+ * it starts on. Columns are not kept; an error message works them out
+ * from the offsets and the source text when it needs them (see
+ * GetColumns() in scanner.h), which takes the column counting off the
+ * scanner's path. The line stays because a location can outlive the
+ * text it points into (a prelude's declarations, or streamed input
+ * that has been dropped), and the scanner counts lines anyway.
  */
 typedef struct yyltype
 {
-    int timestamp;                 // you can ignore this field
-    int first_line, first_column;
-    int last_line, last_column;      
-    char *text;                    // you can also ignore this field
+    int line;                      // the line it starts on
+    unsigned int offset;           // where it starts, in bytes
+    unsigned int length;           // how many bytes it spans
 } yyltype;
 
 #define YYLTYPE yyltype
 
 
-/* Global variable: yylloc
- * ------------------------
- * The global variable holding the position information about the
- * lexeme just scanned.
- */
-extern struct yyltype yylloc;
-
 
 /* Function: Join
  * --------------
@@ -40,11 +40,9 @@ extern struct yyltype yylloc;
  */
 inline yyltype Join(yyltype first, yyltype last)
 {
-  yyltype combined;
-  combined.first_column = first.first_column;
-  combined.first_line = first.first_line;
-  combined.last_column = last.last_column;
-  combined.last_line = last.last_line;
+  yyltype combined = first;
+  if (last.offset + last.length > first.offset + first.length)
+    combined.length = last.offset + last.length - first.offset;
   return combined;
 }
 
@@ -1,7 +1,7 @@
 /* File: main.cc
  * -------------
- * This file defines the main() routine for the program and not much else.
- * You should not need to modify this file.
+ * This file defines the main() routine for the program and the few
+ * helpers that set up each kind of compilation from the options.
  */
  
 #include <string.h>
@@ -9,22 +9,269 @@
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "source.h"
+#include "atom.h"
+#include "tokencache.h"
+#include "preprocess.h"
+#include "prelude.h"
+#include "fingerprint.h"
+#include <map>
 
 
+/* Function: ChooseLexer()
+ * -----------------------
+ * Maps the -lexer= option to the lexer the session should use. The
+ * flex scanner is the default.
+ */
+static LexerKind ChooseLexer()
+{
+    const char *choice = GetOption("lexer");
+    if (!choice || !strcmp(choice, "flex")) return L_Flex;
+    if (!strcmp(choice, "fast")) return L_Fast;
+    if (!strcmp(choice, "diff")) return L_Diff;
+    if (!strcmp(choice, "stream")) return L_Stream;
+    printf("Unknown lexer '%s' (expected fast, flex, diff or stream)\n", choice);
+    exit(2);
+}
+
+/* Function: ChooseParser()
+ * ------------------------
+ * Maps the -parser= option to the parser the session should run. The
+ * bison parser is the default.
+ */
+static ParserKind ChooseParser()
+{
+    const char *choice = GetOption("parser");
+    if (!choice || !strcmp(choice, "bison")) return P_Bison;
+    if (!strcmp(choice, "rd")) return P_RD;
+    printf("Unknown parser '%s' (expected bison or rd)\n", choice);
+    exit(2);
+}
+
+/* Function: ChooseTokenMode()
+ * ---------------------------
+ * Maps the -tokens= option to how the parser gets its tokens: scanned
+ * a token at a time as the parser asks for them (pull, the default),
+ * all scanned before parsing starts (buffer), or scanned on a thread of
+ * their own alongside the parser (thread).
+ */
+enum TokenMode { PullTokens, BufferTokens, ThreadTokens };
+
+static TokenMode ChooseTokenMode()
+{
+    const char *choice = GetOption("tokens");
+    if (!choice || !strcmp(choice, "pull")) return PullTokens;
+    if (!strcmp(choice, "buffer")) return BufferTokens;
+    if (!strcmp(choice, "thread")) return ThreadTokens;
+    printf("Unknown token mode '%s' (expected buffer, pull or thread)\n", choice);
+    exit(2);
+}
+
+/* Function: ParseStream()
+ * ------------------------
+ * Compiles the input with -lexer=stream, which reads it a chunk at a
+ * time rather than all at once. Returns the number of errors.
+ */
+static int ParseStream(const char *path, ParserKind parser, const Prelude *prelude)
+{
+    if (ChooseTokenMode() != PullTokens || GetOption("token-cache") ||
+        NumInputFiles() > 1 || GetOption("fingerprint")) {
+        printf("-lexer=stream cannot be used with -tokens=buffer, -tokens=thread, "
+               "-token-cache, -fingerprint or more than one input\n");
+        exit(2);
+    }
+    FILE *in = path ? fopen(path, "rb") : stdin;
+    if (!in) {
+        ReportError::Formatted(NULL, "Cannot read input file '%s'", path);
+        return -1;
+    }
+    ParserSession session(in);
+    session.SetParser(parser);
+    session.SetSyntaxOnly(GetOption("syntax-only") != NULL);
+    session.SetLazyBodies(GetOption("lazy-bodies") != NULL);
+    if (path) session.SetFileName(path);
+    session.SetPrelude(prelude);
+    int errors = session.Parse();
+    if (path) fclose(in);
+    return errors;
+}
+
+/* Function: ChooseFingerprint()
+ * -----------------------------
+ * Reads -fingerprint=: print has each input's fingerprint printed as
+ * it is compiled, only has them printed and nothing compiled. Returns
+ * whether they are printed at all.
+ */
+static bool ChooseFingerprint(bool *only)
+{
+    const char *choice = GetOption("fingerprint");
+    *only = false;
+    if (!choice) return false;
+    if (!strcmp(choice, "print")) return true;
+    if (!strcmp(choice, "only")) return (*only = true);
+    printf("Unknown fingerprint mode '%s' (expected print or only)\n", choice);
+    exit(2);
+}
+
+/* Function: ReadSource()
+ * ----------------------
+ * Maps the named file, or reads stdin if path is NULL. Returns false
+ * (having reported it) if the input cannot be read.
+ */
+static bool ReadSource(const char *path, SourceBuffer *source)
+{
+    if (path ? source->MapFile(path) : source->ReadStream(stdin)) return true;
+    ReportError::Formatted(NULL, "Cannot read input file '%s'",
+                           path ? path : "<stdin>");
+    return false;
+}
+
+/* Function: ScanAhead()
+ * ---------------------
+ * Fills the session's token buffer before parsing: from the token
+ * cache if -token-cache= names one and it has the tokens, otherwise by
+ * scanning (and then storing them in the cache, if they scanned
+ * cleanly).
+ */
+static void ScanAhead(ParserSession *session, SourceBuffer *source)
+{
+    const char *cacheDir = GetOption("token-cache");
+    TokenBuffer *cached = cacheDir ? TokenCache::Load(cacheDir, source->GetBase(),
+                                                      source->GetLength()) : NULL;
+    if (cached) {
+        session->SetTokens(cached);
+        return;
+    }
+    session->LexAhead();
+    if (cacheDir && ReportError::NumErrors() == 0)
+        TokenCache::Store(cacheDir, session->GetTokens());
+}
+
+/* Function: CompileBatch()
+ * ------------------------
+ * Compiles each input named on the command line in turn. Every input
+ * is scanned ahead and fingerprinted (see fingerprint.h); one whose
+ * tokens match an input compiled earlier in the batch is not parsed or
+ * checked again, but gets that input's errors, moved to the same
+ * places in its own text. An input with lexical errors, or that
+ * includes a file with them, is always compiled on its own. With
+ * -fingerprint=only the inputs are scanned and fingerprinted and
+ * nothing more. Returns the number of inputs with errors.
+ */
+struct Compiled {
+    TokenBuffer *tokens;        // only their places are used; the source is gone
+    std::vector<ReportError::Diagnostic> diagnostics;
+};
+
+static int CompileBatch(LexerKind lexer, ParserKind parser, const Prelude *prelude)
+{
+    bool only, print = ChooseFingerprint(&only);
+    std::map<uint64_t, Compiled> compiled;
+    int inputs = NumInputFiles() ? NumInputFiles() : 1;
+    int failed = 0, parsed = 0, reused = 0;
+    for (int i = 0; i < inputs; i++) {
+        const char *path = GetInputFile(i);
+        if (inputs > 1 && !only) {
+            fflush(stdout);
+            fprintf(stderr, "\n=== %s ===\n", path);
+        }
+        ReportError::Reset();
+        SourceBuffer source;
+        if (!ReadSource(path, &source)) {
+            failed++;
+            continue;
+        }
+        ParserSession session(&source, lexer);
+        session.SetParser(parser);
+        session.SetSyntaxOnly(GetOption("syntax-only") != NULL);
+        session.SetLazyBodies(GetOption("lazy-bodies") != NULL);
+        if (path) session.SetFileName(path);
+        session.SetPrelude(prelude);
+        ScanAhead(&session, &source);
+        bool clean = (ReportError::NumErrors() == 0);
+        if (print)
+            printf("%016llx  %s\n", (unsigned long long)Fingerprint::Of(session.GetTokens()),
+                   path ? path : "-");
+        if (!only) {
+            uint64_t key = Fingerprint::BatchKey(session.GetTokens(), path);
+            std::map<uint64_t, Compiled>::iterator it = compiled.find(key);
+            if (clean && it != compiled.end()) {
+                session.Replay(it->second.diagnostics, it->second.tokens);
+                reused++;
+            } else {
+                Compiled result;
+                ReportError::Record(&result.diagnostics);
+                session.Parse();
+                parsed++;
+                ReportError::Record(NULL);
+                if (clean && session.GetPreprocessor()->NumIncludeErrors() == 0) {
+                    result.tokens = session.TakeTokens();
+                    compiled[key] = result;
+                }
+            }
+        }
+        if (ReportError::NumErrors() > 0) failed++;
+    }
+    PrintDebug("fingerprint", "%d inputs, %d compiled, %d reused", inputs,
+               parsed, reused);
+    return failed;
+}
+
 /* Function: main()
  * ----------------
- * Entry point to the entire program.  We parse the command line and turn
- * on any debugging flags requested by the user when invoking the program.
- * InitScanner() is used to set up the scanner.
- * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * Entry point to the entire program. Reads the command line (the
+ * usage message in utility.cc lists the options), then compiles the
+ * input: as a stream with -lexer=stream, as a batch with several
+ * inputs or with -fingerprint=, and otherwise in one ParserSession.
+ * Returns 0 if there were no errors.
  */
 int main(int argc, char *argv[])
 {
     ParseCommandLine(argc, argv);
-    InitScanner();
+    LexerKind lexer = ChooseLexer();
+    ParserKind parser = ChooseParser();
+    TokenMode mode = ChooseTokenMode();
     InitParser();
-    yyparse();
+    const char *path = GetInputFile();
+    if (GetOption("include-path"))
+        Preprocessor::SetIncludePath(GetOption("include-path"));
+    const Prelude *prelude = NULL;
+    if (GetOption("prelude") &&
+        !(prelude = Prelude::Load(GetOption("prelude"), lexer, parser)))
+        return -1;
+    if (lexer == L_Stream) {
+        int errors = ParseStream(path, parser, prelude);
+        AtomTable::PrintStats();
+        Preprocessor::PrintStats();
+        Prelude::PrintStats();
+        return (errors == 0? 0 : -1);
+    }
+    if (NumInputFiles() > 1 || GetOption("fingerprint")) {
+        int failed = CompileBatch(lexer, parser, prelude);
+        AtomTable::PrintStats();
+        TokenCache::PrintStats();
+        Preprocessor::PrintStats();
+        Prelude::PrintStats();
+        return (failed == 0? 0 : -1);
+    }
+    SourceBuffer source;
+    if (!ReadSource(path, &source))
+        return -1;
+    ParserSession session(&source, lexer);
+    session.SetParser(parser);
+    session.SetSyntaxOnly(GetOption("syntax-only") != NULL);
+    session.SetLazyBodies(GetOption("lazy-bodies") != NULL);
+    if (path) session.SetFileName(path);
+    session.SetPrelude(prelude);
+    if (GetOption("token-cache") || mode == BufferTokens)
+        ScanAhead(&session, &source);
+    else if (mode == ThreadTokens)
+        session.ScanOnThread();
+    session.Parse();
+    AtomTable::PrintStats();
+    TokenCache::PrintStats();
+    Preprocessor::PrintStats();
+    Prelude::PrintStats();
     return (ReportError::NumErrors() == 0? 0 : -1);
 }
 
@@ -10,13 +10,19 @@
   // here we need to include things needed for the yylval union
   // (types, classes, constants, etc.)
   
+#include <thread>
 #include "scanner.h"            // for MaxIdentLen
+#include "fastlex.h"
+#include "streamlex.h"
+#include "tokens.h"
+#include "atom.h"               // identifiers in yylval are atoms
 #include "list.h"       	// because we use all these types
 #include "ast.h"		// in the union, we need their declarations
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
+#include "errors.h"
 
  
 // Next, we want to get the exported defines for the token codes and
@@ -28,11 +34,205 @@
 // we are compiling y.tab.c, which we use the YYBISON symbol for. 
 // Managing C headers can be such a mess! 
 
+class ParserSession;            // y.tab.h names it in yyparse's parameters
+class Preprocessor;
+class Prelude;
+class TokenRing;
+class Arena;
+struct yypstate;                // the push parser's state
+
 #ifndef YYBISON                 
 #include "y.tab.h"              
 #endif
 
-int yyparse();              // Defined in the generated y.tab.c file
+int yyparse(ParserSession *session); // Defined in the generated y.tab.c file
 void InitParser();          // Defined in parser.y
 
+/* Enum: LexerKind
+ * ---------------
+ * Which lexer a session reads its tokens from (the -lexer= option):
+ * the flex scanner, the hand-written one in fastlex.h, or both at
+ * once. With L_Diff every token is scanned twice and compilation
+ * stops with a Failure at the first token where the two disagree; the
+ * parser gets the flex scanner's tokens. Scanner diagnostics are
+ * printed by both lexers in that mode, so they show up twice. L_Stream
+ * is the hand-written lexer reading a stream a chunk at a time (see
+ * streamlex.h); it has no SourceBuffer, so the whole-input features
+ * (LexAhead, the token cache) are not available with it.
+ */
+enum LexerKind { L_Flex, L_Fast, L_Diff, L_Stream };
+
+/* Enum: ParserKind
+ * ----------------
+ * Which parser a session's Parse() runs (the -parser= option): the
+ * bison parser generated from parser.y, or the hand-written one in
+ * rdparse.h, which builds the same tree.
+ */
+enum ParserKind { P_Bison, P_RD };
+
+/* Class: ParserSession
+ * --------------------
+ * One compilation: the lexer reading its source, the preprocessor
+ * between that and the parser, and the Program the parser built from
+ * it. Sessions share no state, so each worker thread
+ * can run its own. While Parse() runs, the session is the current
+ * session of its thread; that is how the error reporter finds the
+ * source lines to underline.
+ */
+class ParserSession {
+  protected:
+    LexerKind lexer;
+    ParserKind parser;
+    bool checking;              // Parse() checks the program it builds
+    bool syntaxOnly;            // Parse() builds no program at all
+    bool lazyBodies;            // function bodies are left for later
+    SourceBuffer *source;       // NULL with L_Stream
+    yyscan_t scanner;           // flex scanner, NULL with L_Fast
+    FastLexer *fastLexer;       // hand-written lexer, NULL with L_Flex
+    StreamLexer *streamLexer;   // only with L_Stream
+    yyltype *lastLoc;           // location of the token last scanned
+    TokenBuffer *tokens;        // all tokens, if LexAhead() was called
+    int nextToken;              // index of the next one to hand the parser
+    TokenRing *ring;            // tokens from the scanning thread, if any
+    std::thread scanThread;
+    int scanErrors;             // errors the scanning thread reported
+    ScannerState *lines;        // the parser's own line index, if any
+    void IndexLines();
+    ScannerState *OwnLines(int n);
+    Preprocessor *preprocessor; // between the tokens and the parser
+    const Prelude *prelude;     // what the input starts from, or NULL
+    Program *program;
+    Arena *arena;               // where the AST is allocated
+    ParserSession *saved;       // session that was current before Parse()
+    yypstate *pushState;        // the parse Feed() is in the middle of
+    yyltype pushedLoc;          // the location of the token last fed
+    int pushErrors;             // errors reported in Feed() so far
+    bool pushing;               // Feed() has started a parse
+    static thread_local ParserSession *current;
+
+  public:
+    ParserSession(SourceBuffer *source, LexerKind lexer = L_Flex);
+                                // source must outlive the session
+    ParserSession(FILE *in);    // an L_Stream session reading in
+    ~ParserSession();
+
+        // Scans the whole input into a TokenBuffer before parsing, so
+        // that Parse() reads tokens from memory. Scanner diagnostics
+        // then all come out before any syntax errors.
+    void LexAhead();
+    TokenBuffer *GetTokens()        { return tokens; }
+
+        // Scans on a thread of its own while Parse() parses, the tokens
+        // passing between them through a TokenRing (see tokenring.h).
+        // Call it just before Parse().
+    void ScanOnThread();
+        // Hands the TokenBuffer over to the caller, who then owns it
+    TokenBuffer *TakeTokens();
+
+        // Parses from tokens scanned earlier (say, loaded from the token
+        // cache) instead of scanning. The session takes ownership.
+    void SetTokens(TokenBuffer *buffer);
+
+        // Parses (and, if there were no syntax errors, checks) the whole
+        // input. Returns the number of errors reported.
+    int Parse();
+
+        // Which parser Parse() runs (the bison one unless set), and
+        // whether it checks the program afterwards (it does unless told
+        // not to; the program is built either way)
+    void SetParser(ParserKind p)    { parser = p; }
+    ParserKind GetParserKind()      { return parser; }
+    void SetChecking(bool check)    { checking = check; }
+
+        // Has Parse() only look for syntax errors (-syntax-only): the
+        // hand-written parser runs, whichever is set, and builds
+        // nothing, so there is no program afterwards and nothing is
+        // checked. It allocates nothing per token or node, so with
+        // tokens pulled as it goes its memory does not grow with the
+        // input. Feed() is unaffected.
+    void SetSyntaxOnly(bool only)   { syntaxOnly = only; }
+
+        // Has Parse() skip each function body by matching its braces
+        // and leave a LazyBody in its place, to be parsed the first time
+        // FnDecl::GetBody() is called: by the checker, a printer, or the
+        // caller (while the source is still around). For when only the
+        // declarations are wanted, with checking turned off; a checked
+        // program has every body parsed before the check, even after
+        // other errors, the first syntax error stopping it as usual,
+        // though errors in bodies come after any among the
+        // declarations, and a skipped body is scanned to its end,
+        // lexical errors and all. Like -syntax-only it always runs the
+        // hand-written parser (which SetSyntaxOnly overrides). A body
+        // the preprocessor changed anything in (a macro, a directive)
+        // cannot be scanned again from its text, so it is parsed right
+        // away, as are all bodies with L_Stream.
+    void SetLazyBodies(bool lazy)   { lazyBodies = lazy; }
+    bool GetLazyBodies()            { return lazyBodies; }
+    SourceBuffer *GetSource()       { return source; }
+
+        // Instead of Parse(), the caller scans and hands the parser one
+        // token at a time, ending with token 0, as its input arrives.
+        // Returns true while the parser wants more; once it returns
+        // false the parse (and check) is done and FedErrors() has the
+        // count. Fed tokens go straight to the parser: the caller's own
+        // tokenizer takes the preprocessor's place. Line text for error
+        // messages comes from the session's source (which may be empty).
+        // It is always the bison parser's push form, whatever the
+        // parser set.
+    bool Feed(int token, const YYSTYPE *lval, const yyltype *loc);
+    int FedErrors()                 { return pushErrors; }
+
+        // Instead of Parse(), reports the errors recorded while parsing
+        // another input with the same fingerprint (its tokens are from),
+        // at the matching places in this one. Needs LexAhead() first.
+    void Replay(const std::vector<ReportError::Diagnostic> &diagnostics,
+                const TokenBuffer *from);
+
+        // The parser's yylex: the next token from the preprocessor
+    int NextToken(YYSTYPE *lval, yyltype *loc);
+
+        // What the preprocessor reads: the next token from the
+        // TokenBuffer if there is one, else scans it
+    int RawToken(YYSTYPE *lval, yyltype *loc);
+
+        // What the scanning thread runs
+    void ScanLoop();
+
+        // Scans the next token with whichever lexer the session uses
+    int Scan(YYSTYPE *lval, yyltype *loc);
+
+        // Text of source line n (NULL if unavailable), and the location
+        // of the last token scanned (NULL before the first)
+    const char *GetLineNumbered(int n);
+    yyltype *GetLastLocation()      { return lastLoc; }
+
+        // Where line n starts (false if unavailable), and the columns a
+        // location starts and ends at, worked out from its offsets
+    bool GetLineStart(int n, unsigned int *offset);
+    bool GetColumns(const yyltype *loc, int *first, int *last);
+
+        // The path of the source, which #include "file" looks next to
+    void SetFileName(const char *path);
+    LexerKind GetLexerKind()        { return lexer; }
+
+        // Starts the compilation from a prelude's snapshot (see
+        // prelude.h): its macros are defined, and its declarations in
+        // scope, before the first token. Call it before Parse().
+    void SetPrelude(const Prelude *p);
+    const Prelude *GetPrelude()     { return prelude; }
+    Preprocessor *GetPreprocessor() { return preprocessor; }
+
+        // Called by the parser with the program it has built: the
+        // session keeps it and, if there were no errors, checks it.
+        // False if a function body left for later had a syntax error.
+    bool FinishProgram(Program *p);
+    Program *GetProgram()           { return program; }
+
+        // The AST is freed with the session unless its arena is taken,
+        // which the caller then owns
+    Arena *TakeArena();
+    Arena *GetArena()               { return arena; }
+    static ParserSession *Current() { return current; }
+};
+
 #endif
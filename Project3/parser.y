@@ -16,14 +16,58 @@
  * file inclusions or C++ variable declarations/prototypes that are needed
  * by your code here.
  */
+#include <string.h>   // for memchr
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
 
 void yyerror(const char *msg); // standard error-handling routine
+void yyerror(yyltype *loc, ParserSession *session, const char *msg);
+
+/* The location of a rule (@$) runs from the start of its first symbol
+ * to the end of its last. An empty rule gets an empty location just
+ * after the symbol before it. (Bison's own default works on line and
+ * column fields, which yyltype does not have.)
+ */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                 \
+   do {                                                                 \
+      if (N)                                                            \
+         (Current) = Join(YYRHSLOC(Rhs, 1), YYRHSLOC(Rhs, N));          \
+      else {                                                            \
+         (Current) = YYRHSLOC(Rhs, 0);                                  \
+         (Current).offset += (Current).length;                          \
+         (Current).length = 0;                                          \
+      }                                                                 \
+   } while (0)
 
 %}
 
+/* Reentrancy
+ * ----------
+ * The parser is pure: yylval and yylloc are locals of yyparse rather
+ * than globals, and the owning ParserSession is passed in, so several
+ * parses can run at the same time. Tokens come from the session, which
+ * knows whether to run the flex scanner or the hand-written lexer.
+ *
+ * Bison also generates the push form of the parser (yypush_parse),
+ * whose state lives in a yypstate instead of on the stack of a call
+ * that runs to the end of input; ParserSession::Feed() uses it to take
+ * tokens one at a time from the caller.
+ */
+%define api.pure full
+%define api.push-pull both
+%locations
+%lex-param   {ParserSession *session}
+%parse-param {ParserSession *session}
+
+%code {
+// yyparse calls yylex(&yylval, &yylloc, session)
+static inline int yylex(YYSTYPE *lval, yyltype *loc, ParserSession *session)
+{
+   return session->NextToken(lval, loc);
+}
+}
+
 /* The section before the first %% is the Definitions section of the yacc
  * input file. Here is where you declare tokens and types, add precedence
  * and associativity options, and so on.
@@ -40,9 +84,10 @@ void yyerror(const char *msg); // standard error-handling routine
  */
 %union {
     int integerConstant;
+    unsigned int uintConstant;
     bool boolConstant;
     double floatConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    Atom identifier;            // interned spelling, see atom.h
     Decl *decl;
     FnDecl *funcDecl;
     List<Decl*> *declList;
@@ -83,9 +128,11 @@ void yyerror(const char *msg); // standard error-handling routine
 %token   <identifier> T_Inc T_Dec 
 %token   <identifier> T_Identifier
 %token   <integerConstant> T_IntConstant
+%token   <uintConstant> T_UintConstant
 %token   <floatConstant> T_FloatConstant
 %token   <boolConstant> T_BoolConstant
 %token   <identifier> T_FieldSelection
+%token   <identifier> T_Directive    /* only seen by the preprocessor */
 
 %nonassoc LOWEST
 %nonassoc LOWER_THAN_ELSE
@@ -139,12 +186,7 @@ Program   :    DeclList            {
                                        * it once you have other uses of @n*/
                                       Program *program = new Program($1);
                                       // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) {
-                                          if ( IsDebugOn("dumpAST") ) {
-                                            program->Print(0);
-                                          }
-                                          program->Check();
-                                      }
+                                      session->FinishProgram(program);
                                     }
           ;
 
@@ -178,13 +220,13 @@ Declaration : FuncDecl T_Semicolon   { $$ = $1; }
 
 FuncDecl  : TypeDecl T_Identifier T_LeftParen T_RightParen 
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             List<VarDecl *> *formals = new List<VarDecl *>;
                             $$ = new FnDecl(id, $1, formals);
                          }
           | TypeDecl T_Identifier T_LeftParen ParameterList T_RightParen 
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new FnDecl(id, $1, $4);
                          }
           ;
@@ -195,28 +237,28 @@ ParameterList : SingleDecl { ($$ = new List<VarDecl *>)->Append($1);  }
 
 SingleDecl    : TypeDecl T_Identifier
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new VarDecl(id, $1);
                          }
               | TypeQualify TypeDecl T_Identifier
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$3); 
+                            Identifier *id = new Identifier(yylloc, $3); 
                             $$ = new VarDecl(id, $2, $1);
                          }
               | TypeDecl T_Identifier T_Equal Initializer
                          {
                             // incomplete: drop the initializer here
-                            Identifier *id = new Identifier(yylloc, (const char *)$2); 
+                            Identifier *id = new Identifier(yylloc, $2); 
                             $$ = new VarDecl(id, $1, $4);
                          }
               | TypeQualify TypeDecl T_Identifier T_Equal Initializer
                          {
-                            Identifier *id = new Identifier(yylloc, (const char *)$3); 
+                            Identifier *id = new Identifier(yylloc, $3); 
                             $$ = new VarDecl(id, $2, $1, $5);
                          }
               | TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket 
                          { 
-                            Identifier *id = new Identifier(@2, (const char *)$2);
+                            Identifier *id = new Identifier(@2, $2);
                             $$ = new VarDecl(id, new ArrayType(@1, $1, $4));
                          }
               | TypeQualify TypeDecl T_Identifier T_LeftBracket T_IntConstant T_RightBracket 
@@ -239,6 +281,7 @@ TypeQualify    : T_In       {$$ = TypeQualifier::inTypeQualifier;}
 TypeDecl       : T_Int                   { $$ = Type::intType;    }
                | T_Void                  { $$ = Type::voidType;   }
                | T_Float                 { $$ = Type::floatType;  }
+               | T_Uint                  { $$ = Type::uintType;   }
                | T_Bool                  { $$ = Type::boolType;   }
                | T_Vec2                  { $$ = Type::vec2Type;   }
                | T_Vec3                  { $$ = Type::vec3Type;   }
@@ -308,10 +351,11 @@ ForStmt            : T_For T_LeftParen Expression T_Semicolon Expression T_Semic
                                  }
                    ;
 
-PrimaryExpr        : T_Identifier    { Identifier *id = new Identifier(yylloc, (const char*)$1);
+PrimaryExpr        : T_Identifier    { Identifier *id = new Identifier(yylloc, $1);
                                        $$ = new VarExpr(yyloc, id);
                                      }
                    | T_IntConstant   { $$ = new IntConstant(yylloc, $1); }
+                   | T_UintConstant  { $$ = new UintConstant(yylloc, $1); }
                    | T_FloatConstant { $$ = new FloatConstant(yylloc, $1); } 
                    | T_BoolConstant  { $$ = new BoolConstant(yylloc, $1); }
                    | T_LeftParen Expression T_RightParen { $$ = $2;}
@@ -342,17 +386,17 @@ PostfixExpr        : PrimaryExpr     { $$ = $1; }
                                        }
                    | PostfixExpr T_Inc 
                                        {
-                                          Operator *op = new Operator(yylloc, (const char *)$2);
+                                          Operator *op = new Operator(yylloc, $2);
                                           $$ = new PostfixExpr($1, op);
                                        }
                    | PostfixExpr T_Dec 
                                        {
-                                          Operator *op = new Operator(yylloc, (const char *)$2);
+                                          Operator *op = new Operator(yylloc, $2);
                                           $$ = new PostfixExpr($1, op);
                                        }
                    | PostfixExpr T_Dot T_FieldSelection
                                        {
-                                          Identifier *id = new Identifier(yylloc, (const char *)$3);
+                                          Identifier *id = new Identifier(yylloc, $3);
                                           $$ = new FieldAccess($1, id);
                                        }
                    ;
@@ -502,3 +546,466 @@ void InitParser()
    PrintDebug("parser", "Initializing parser");
    yydebug = false;
 }
+
+/* Function: yyerror
+ * -----------------
+ * The pure parser reports syntax errors through this form, passing the
+ * location of the offending token along with its own parameters.
+ */
+void yyerror(yyltype *loc, ParserSession *session, const char *msg)
+{
+   ReportError::Formatted(loc, "%s", msg);
+}
+
+/* Class: ParserSession
+ * --------------------
+ * Implementation of the per-compilation object declared in parser.h.
+ */
+#include "preprocess.h"     // here, where YYSTYPE is complete
+#include "prelude.h"
+#include "tokenring.h"
+#include "fingerprint.h"
+#include "arena.h"
+#include "rdparse.h"
+
+thread_local ParserSession *ParserSession::current = NULL;
+
+// Set on a scanning thread (see ScanLoop()), which uses the lexer's
+// line index rather than the parser's. Not std::thread::get_id() on
+// scanThread, which is still being assigned as the thread starts.
+static thread_local bool onScanThread = false;
+
+ParserSession::ParserSession(SourceBuffer *source, LexerKind lexer)
+{
+   this->lexer = lexer;
+   this->source = source;
+   parser = P_Bison;
+   checking = true;
+   syntaxOnly = false;
+   lazyBodies = false;
+   scanner = (lexer != L_Fast) ? InitScanner(source) : NULL;
+   fastLexer = (lexer != L_Flex) ? new FastLexer(source) : NULL;
+   streamLexer = NULL;
+   lastLoc = NULL;
+   tokens = NULL;
+   nextToken = 0;
+   ring = NULL;
+   scanErrors = 0;
+   lines = NULL;
+   preprocessor = new Preprocessor(this);
+   prelude = NULL;
+   program = NULL;
+   arena = new Arena;
+   saved = NULL;
+   pushState = NULL;
+   pushErrors = 0;
+   pushing = false;
+}
+
+ParserSession::ParserSession(FILE *in)
+{
+   lexer = L_Stream;
+   source = NULL;
+   parser = P_Bison;
+   checking = true;
+   syntaxOnly = false;
+   lazyBodies = false;
+   scanner = NULL;
+   fastLexer = NULL;
+   streamLexer = new StreamLexer(in);
+   lastLoc = NULL;
+   tokens = NULL;
+   nextToken = 0;
+   ring = NULL;
+   scanErrors = 0;
+   lines = NULL;
+   preprocessor = new Preprocessor(this);
+   prelude = NULL;
+   program = NULL;
+   arena = new Arena;
+   saved = NULL;
+   pushState = NULL;
+   pushErrors = 0;
+   pushing = false;
+}
+
+ParserSession::~ParserSession()
+{
+   if (ring) {                       // ScanOnThread() without Parse()
+      ring->Stop();
+      scanThread.join();
+      delete ring;
+   }
+   delete lines;
+   if (pushState) yypstate_delete(pushState);
+   if (scanner) FreeScanner(scanner);
+   delete fastLexer;
+   delete streamLexer;
+   delete preprocessor;
+   delete tokens;
+   if (program) program->ReleaseGlobals();   // the tree may live on (TakeArena)
+   if (arena) {
+      arena->PrintStats("AST");
+      delete arena;                  // and with it the whole tree
+   }
+}
+
+/* The error count is not reset, here or again in Parse(), so the
+ * lexers' diagnostics count toward the errors Parse() returns. (The
+ * preprocessor scans included files with LexAhead() in the middle of a
+ * parse.)
+ */
+void ParserSession::LexAhead()
+{
+   Assert(tokens == NULL && lexer != L_Stream);
+   saved = current;
+   current = this;
+
+   ScannerState *state = scanner ? GetScannerState(scanner) : fastLexer->GetState();
+   TokenBuffer *buffer = new TokenBuffer(state->base, state->length);
+   YYSTYPE lval;
+   yyltype loc = {};
+   int token;
+   do {
+      token = Scan(&lval, &loc);
+      buffer->Append(token, &lval, &loc);
+   } while (token != 0);
+   buffer->source.lineStarts = state->lineStarts;
+   PrintDebug("tokens", "%d tokens, %lu values", buffer->NumTokens(),
+              (unsigned long)buffer->valueTable.size());
+   tokens = buffer;     // only now, so lexer errors above found their lines
+   current = saved;
+}
+
+TokenBuffer *ParserSession::TakeTokens()
+{
+   TokenBuffer *buffer = tokens;
+   tokens = NULL;
+   return buffer;
+}
+
+void ParserSession::SetFileName(const char *path)
+{
+   preprocessor->SetFileName(path);
+}
+
+void ParserSession::SetPrelude(const Prelude *p)
+{
+   prelude = p;
+   if (prelude) preprocessor->SetMacros(prelude->GetMacros());
+}
+
+/* Called from the Program rule (or the end of RDParser::Parse()), once
+ * the parser has read every declaration it can: usually at the end of
+ * the input, but a stray token after a declaration also ends the list,
+ * and the syntax error for it is reported after this. Function bodies
+ * left for later are parsed first, even after errors (a lexical one
+ * does not stop the eager parse either), so that they report the
+ * syntax errors it would and one stops the check as any other would;
+ * returns false after one.
+ */
+bool ParserSession::FinishProgram(Program *p)
+{
+   program = p;
+   if (prelude) program->StartFrom(prelude->GetGlobals());
+   if (!checking) return true;
+   if (!program->ParseLazyBodies()) return false;
+   if (ReportError::NumErrors() > 0) return true;
+   if (IsDebugOn("dumpAST"))
+      program->Print(0);
+   program->Check();
+   return true;
+}
+
+Arena *ParserSession::TakeArena()
+{
+   Arena *taken = arena;
+   arena = NULL;
+   return taken;
+}
+
+void ParserSession::SetTokens(TokenBuffer *buffer)
+{
+   Assert(tokens == NULL);
+   tokens = buffer;
+   ReportError::Reset();
+}
+
+/* The scanning thread scans the whole input even if the parser stops
+ * early, so it reports the same lexical errors as LexAhead(); they come
+ * out as it finds them, though, so how they fall among the syntax
+ * errors depends on timing. Its error count is handed over with token
+ * 0, before the parser decides whether to check the program (or at the
+ * end of Parse(), if the parser stopped first). Line text for the
+ * parsing thread's errors comes from an index of its own, built only
+ * when an error needs it, since the scanner is adding to the lexer's
+ * index meanwhile.
+ */
+void ParserSession::ScanOnThread()
+{
+   Assert(tokens == NULL && ring == NULL && lexer != L_Stream);
+   IndexLines();
+   ring = new TokenRing;
+   scanThread = std::thread(&ParserSession::ScanLoop, this);
+}
+
+void ParserSession::ScanLoop()
+{
+   current = this;                   // this thread's, for scanner errors
+   onScanThread = true;
+   YYSTYPE lval;
+   yyltype loc = {};
+   int token;
+   bool parsing = true;
+   do {
+      token = Scan(&lval, &loc);
+      if (token == 0) scanErrors = ReportError::NumErrors();
+      if (parsing) parsing = ring->Put(token, &lval, &loc);
+   } while (token != 0);
+}
+
+int ParserSession::Parse()
+{
+   saved = current;
+   current = this;
+   Arena *savedArena = Arena::SetCurrent(arena);
+   if (!tokens) ReportError::Reset();
+   if (syntaxOnly)
+      RDParser(this, false).Parse();
+   else if (parser == P_RD || lazyBodies)
+      RDParser(this).Parse();
+   else
+      yyparse(this);
+   if (ring) {
+      ring->Stop();
+      scanThread.join();
+      ReportError::AddErrors(scanErrors);   // if the parser stopped first
+      scanErrors = 0;
+      delete ring;
+      ring = NULL;
+   }
+   Arena::SetCurrent(savedArena);
+   current = saved;
+   return ReportError::NumErrors();
+}
+
+/* The error count is per thread, and a caller feeding several sessions
+ * from one thread switches between them token by token, so each Feed()
+ * swaps the session's own count in for the call and the thread's back
+ * out after it. The parse (and the check, which the Program rule runs)
+ * happens inside the call that feeds the last token.
+ */
+bool ParserSession::Feed(int token, const YYSTYPE *lval, const yyltype *loc)
+{
+   if (pushState == NULL) {
+      if (pushing) return false;     // that parse is over
+      pushState = yypstate_new();
+      pushing = true;
+      IndexLines();
+   }
+   saved = current;
+   current = this;
+   Arena *savedArena = Arena::SetCurrent(arena);
+   int threadErrors = ReportError::NumErrors();
+   ReportError::Reset();
+   ReportError::AddErrors(pushErrors);
+
+   pushedLoc = *loc;
+   lastLoc = &pushedLoc;
+   int status = yypush_parse(pushState, token, lval, &pushedLoc, this);
+
+   pushErrors = ReportError::NumErrors();
+   ReportError::Reset();
+   ReportError::AddErrors(threadErrors);
+   Arena::SetCurrent(savedArena);
+   current = saved;
+   if (status == YYPUSH_MORE) return true;
+   yypstate_delete(pushState);
+   pushState = NULL;
+   return false;
+}
+
+void ParserSession::Replay(const std::vector<ReportError::Diagnostic> &diagnostics,
+                           const TokenBuffer *from)
+{
+   Assert(tokens != NULL);
+   saved = current;
+   current = this;
+   for (size_t i = 0; i < diagnostics.size(); i++) {
+      ReportError::Diagnostic d = diagnostics[i];
+      if (d.located) Fingerprint::Remap(&d.loc, from, tokens);
+      if (d.referenced) Fingerprint::Remap(&d.ref, from, tokens);
+      ReportError::Replay(&d);
+   }
+   current = saved;
+}
+
+/* Compares the two lexers' versions of a token: code, location and,
+ * for tokens that carry one, the value.
+ */
+static bool SameToken(int token, YYSTYPE *val, yyltype *loc,
+                      int other, YYSTYPE *otherVal, yyltype *otherLoc)
+{
+   if (token != other) return false;
+   if (token == 0) return true;      // end of input has no location
+   if (loc->line != otherLoc->line || loc->offset != otherLoc->offset ||
+       loc->length != otherLoc->length)
+      return false;
+   switch (ValueKindOf(token)) {
+     case V_None:    return true;
+     case V_Integer: return val->integerConstant == otherVal->integerConstant;
+     case V_Uint:    return val->uintConstant == otherVal->uintConstant;
+     case V_Float:   return val->floatConstant == otherVal->floatConstant;
+     case V_Bool:    return val->boolConstant == otherVal->boolConstant;
+     case V_Atom:    return val->identifier == otherVal->identifier;
+   }
+   return false;
+}
+
+int ParserSession::NextToken(YYSTYPE *lval, yyltype *loc)
+{
+   lastLoc = loc;
+   return preprocessor->NextToken(lval, loc);
+}
+
+int ParserSession::RawToken(YYSTYPE *lval, yyltype *loc)
+{
+   if (tokens) return tokens->Fetch(nextToken++, lval, loc);
+   if (ring) {
+      int token = ring->Get(lval, loc);
+      if (token == 0) {
+         ReportError::AddErrors(scanErrors);
+         scanErrors = 0;
+      }
+      return token;
+   }
+   return Scan(lval, loc);
+}
+
+int ParserSession::Scan(YYSTYPE *lval, yyltype *loc)
+{
+   if (lexer == L_Flex) return yylex(lval, loc, scanner);
+   if (lexer == L_Fast) return fastLexer->NextToken(lval, loc);
+   if (lexer == L_Stream) return streamLexer->NextToken(lval, loc);
+
+   YYSTYPE fastVal = *lval;
+   yyltype fastLoc = *loc;
+   int token = yylex(lval, loc, scanner);
+   int fastToken = fastLexer->NextToken(&fastVal, &fastLoc);
+   if (!SameToken(token, lval, loc, fastToken, &fastVal, &fastLoc))
+      Failure("Lexers disagree: flex scanned token %d at line %d, "
+              "bytes %u+%u, fast scanned token %d at line %d, bytes %u+%u",
+              token, loc->line, loc->offset, loc->length,
+              fastToken, fastLoc.line, fastLoc.offset, fastLoc.length);
+   return token;
+}
+
+/* Starts the parser's own line index, for when the lexer's is not
+ * there to use: another thread is adding to it, or the tokens are fed
+ * in and the session's lexer never runs.
+ */
+void ParserSession::IndexLines()
+{
+   if (lines || lexer == L_Stream) return;
+   ScannerState *state = scanner ? GetScannerState(scanner) : fastLexer->GetState();
+   lines = new ScannerState;
+   lines->base = state->base;
+   lines->length = state->length;
+}
+
+/* Returns the parser's own line index, indexed far enough to have line
+ * n if the source does, or NULL if it should use the lexer's.
+ */
+ScannerState *ParserSession::OwnLines(int n)
+{
+   if (!lines || onScanThread) return NULL;
+   while (lines->lineStarts.size() <= n) {
+      const char *start = lines->base + lines->lineStarts.back();
+      const char *nl = (const char *)memchr(start, '\n',
+                                            lines->base + lines->length - start);
+      if (!nl) break;
+      lines->lineStarts.push_back(nl + 1 - lines->base);
+   }
+   return lines;
+}
+
+const char *ParserSession::GetLineNumbered(int n)
+{
+   if (tokens) return tokens->source.GetLine(n);
+   if (ScannerState *index = OwnLines(n)) return index->GetLine(n);
+   if (lexer == L_Fast) return fastLexer->GetLineNumbered(n);
+   if (lexer == L_Stream) return streamLexer->GetLineNumbered(n);
+   return ::GetLineNumbered(scanner, n);
+}
+
+bool ParserSession::GetLineStart(int n, unsigned int *offset)
+{
+   if (tokens) return tokens->source.GetLineStart(n, offset);
+   if (ScannerState *index = OwnLines(n)) return index->GetLineStart(n, offset);
+   if (lexer == L_Fast) return fastLexer->GetState()->GetLineStart(n, offset);
+   if (lexer == L_Stream) return streamLexer->GetLineStart(n, offset);
+   return GetScannerState(scanner)->GetLineStart(n, offset);
+}
+
+/* The columns are counted in the text of the lines, as GetLineNumbered()
+ * gives it. A location that does not fall inside its line (a token of
+ * an #included file, whose offsets are in that file) has none. A
+ * location that runs onto later lines ends at a column of the line it
+ * ends on. Offset arithmetic is modulo 2^32, as the stream lexer's
+ * offsets wrap.
+ */
+bool ParserSession::GetColumns(const yyltype *loc, int *first, int *last)
+{
+   unsigned int start, next;
+   const char *text = GetLineNumbered(loc->line);
+   if (!text || !GetLineStart(loc->line, &start)) return false;
+   unsigned int into = loc->offset - start;
+   if (into > strlen(text)) return false;
+   *first = ColumnOf(text, into);
+
+   unsigned int span = loc->length ? loc->length - 1 : 0;
+   int n = loc->line;
+   while (GetLineStart(n + 1, &next) && next - loc->offset <= span) {
+      n++;
+      start = next;
+   }
+   if (n != loc->line && !(text = GetLineNumbered(n))) return false;
+   unsigned int to = loc->offset + span - start;
+   size_t length = strlen(text);
+   *last = ColumnOf(text, to < length ? to : length);
+   return true;
+}
+
+/* Function: GetLineNumbered()
+ * ---------------------------
+ * Returns the text of line n of the source being compiled on this
+ * thread, or NULL if it is not available.
+ */
+const char *GetLineNumbered(int n)
+{
+   ParserSession *session = ParserSession::Current();
+   return session ? session->GetLineNumbered(n) : NULL;
+}
+
+/* Function: GetColumns()
+ * -----------------------
+ * Sets *first and *last to the columns where loc starts and ends, in
+ * the source being compiled on this thread. Returns false if its text
+ * is not available.
+ */
+bool GetColumns(const yyltype *loc, int *first, int *last)
+{
+   ParserSession *session = ParserSession::Current();
+   return session ? session->GetColumns(loc, first, last) : false;
+}
+
+/* Function: GetLastLocation()
+ * ---------------------------
+ * Returns the location of the token most recently scanned by the
+ * compilation running on this thread, or NULL if there is none.
+ */
+yyltype *GetLastLocation()
+{
+   ParserSession *session = ParserSession::Current();
+   return session ? session->GetLastLocation() : NULL;
+}
@@ -0,0 +1,63 @@
+/* File: prelude.cc
+ * ----------------
+ * Implementation of prelude snapshots. The table of snapshots is
+ * guarded by a mutex, which is held while a prelude compiles, so
+ * compilations that want the same prelude at once wait for the one
+ * compiling it rather than all compiling it.
+ */
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include "prelude.h"
+#include "symtable.h"
+#include "errors.h"
+#include "utility.h"
+
+static std::mutex preludeLock;
+static std::map<std::string, Prelude *> preludes;
+static std::atomic<unsigned long> numCompiled(0), numReused(0);
+
+const Prelude *Prelude::Load(const char *path, LexerKind lexer, ParserKind parser) {
+    SourceBuffer source;
+    if (!source.MapFile(path)) {
+        ReportError::Formatted(NULL, "Cannot read prelude '%s'", path);
+        return NULL;
+    }
+    uint64_t hash = HashText(source.GetBase(), source.GetLength());
+
+    std::lock_guard<std::mutex> lock(preludeLock);
+    Prelude *&entry = preludes[path];
+    if (entry && entry->length == source.GetLength() && entry->hash == hash) {
+        numReused++;
+        return entry;
+    }
+    if (entry) PrintDebug("prelude", "%s has changed, compiling it again", path);
+
+    // compiled by a session of its own, so its errors quote its lines
+    ParserSession session(&source, lexer == L_Stream ? L_Fast : lexer);
+    session.SetFileName(path);
+    session.SetParser(parser);
+    if (session.Parse() > 0 || !session.GetProgram()) {
+        ReportError::Formatted(NULL, "Prelude '%s' has errors", path);
+        return NULL;
+    }
+    Prelude *prelude = new Prelude;
+    prelude->path = path;
+    prelude->length = source.GetLength();
+    prelude->hash = hash;
+    prelude->program = session.GetProgram();
+    prelude->arena = session.TakeArena();   // kept as long as the snapshot
+    prelude->globals = new ScopedTable(*prelude->program->GetGlobals());
+    prelude->macros = session.GetPreprocessor()->GetMacros();
+    PrintDebug("prelude", "Compiled %s: %lu macros", path,
+               (unsigned long)prelude->macros.size());
+    entry = prelude;
+    numCompiled++;
+    return prelude;
+}
+
+void Prelude::PrintStats() {
+    PrintDebug("prelude", "%lu preludes compiled, %lu reused",
+               numCompiled.load(), numReused.load());
+}
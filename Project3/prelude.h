@@ -0,0 +1,59 @@
+/* File: prelude.h
+ * ---------------
+ * A prelude is a header every shader of a project begins with (the
+ * -prelude=<file> option). Rather than scan, parse and check it again
+ * in front of each shader, it is compiled once, on its own, and what
+ * it leaves behind is kept as a snapshot: its Program, the global
+ * scope of the symbol table after checking it, and the macros it
+ * defined. A session given the snapshot (ParserSession::SetPrelude)
+ * starts from it, as if the prelude's text came before its own, much
+ * like a precompiled header. The prelude's declarations are in scope
+ * but not part of the shader's Program, so dumpAST does not print them.
+ *
+ * Snapshots are shared by every compilation in the process. Each one
+ * records the length and hash of the bytes it was made from, and every
+ * Load() hashes the file again: if the bytes have changed, the prelude
+ * is compiled again and the new snapshot replaces the old one. Old
+ * snapshots are never freed, since sessions may still be reading them.
+ */
+
+#ifndef _H_prelude
+#define _H_prelude
+
+#include <stdint.h>
+#include <string>
+#include "preprocess.h"
+
+class ScopedTable;
+
+class Prelude
+{
+  protected:
+    std::string path;
+    size_t length;
+    uint64_t hash;                  // of the bytes the snapshot is of
+    Program *program;               // the prelude's declarations, checked
+    Arena *arena;                   // which they are allocated in
+    ScopedTable *globals;           // the global scope after checking them
+    Preprocessor::MacroTable macros;
+
+    Prelude() {}
+
+  public:
+        // Returns the snapshot of the prelude at path, compiling the
+        // prelude first if there is no snapshot or the file's bytes
+        // differ from it. Returns NULL if the file cannot be read or
+        // has errors (which are reported). Either parser builds the
+        // same snapshot, so one compiled by the other is reused.
+    static const Prelude *Load(const char *path, LexerKind lexer, ParserKind parser);
+
+    const ScopedTable *GetGlobals() const              { return globals; }
+    const Preprocessor::MacroTable &GetMacros() const  { return macros; }
+    Program *GetProgram() const                        { return program; }
+
+        // Prints how often preludes were compiled and reused (debug key
+        // "prelude")
+    static void PrintStats();
+};
+
+#endif
@@ -0,0 +1,693 @@
+/* File: preprocess.cc
+ * -------------------
+ * Implementation of the preprocessor. The table of included files is
+ * shared by every compilation in the process and guarded by a mutex;
+ * an entry, once made, is never changed or freed, so its tokens can be
+ * read without the lock. A file that has changed since it was scanned
+ * gets a new entry in its place, and the old one is left to whoever
+ * is still reading it.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include "preprocess.h"
+#include "errors.h"
+#include "utility.h"
+
+#define MaxIncludeDepth 64      // nested #includes, to stop include cycles
+#define MaxMacroDepth 64        // nested macros in an #if expression
+
+struct IncludeFile {
+    std::string path;           // the real path, which is the table key
+    off_t size;                 // the file as it was scanned, to tell
+    struct timespec modified;   // whether it has changed since
+    SourceBuffer source;
+    TokenBuffer *tokens;
+    Atom guard;                 // the include guard macro, or NULL
+    bool once;                  // has #pragma once
+    std::vector<ReportError::Diagnostic> diagnostics;   // from scanning it
+    ParserSession *scan;        // what scanned it, if there were any, for
+                                // their line text; it owns the tokens then
+};
+
+static std::mutex includeLock;
+static std::map<std::string, IncludeFile *> includeTable;
+static std::vector<std::string> includePath;
+static std::atomic<unsigned long> numScanned(0), numReused(0), numSkipped(0);
+
+static const char *SkipBlanks(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static inline bool IsNameChar(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+           (ch >= '0' && ch <= '9') || ch == '_';
+}
+
+/* Reads the identifier at p (after any blanks) into name, which is left
+ * empty if there is none. Returns the position after it.
+ */
+static const char *ReadName(const char *p, std::string &name) {
+    p = SkipBlanks(p);
+    const char *start = p;
+    if (IsNameChar(*p) && !(*p >= '0' && *p <= '9'))
+        while (IsNameChar(*p)) p++;
+    name.assign(start, p);
+    return p;
+}
+
+static std::string DirName(const std::string &path) {
+    size_t slash = path.rfind('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static const char *DirectiveText(const TokenBuffer *tokens, int i) {
+    return tokens->valueTable[tokens->values[i]].identifier;
+}
+
+/* Looks for an include guard (#ifndef X and #define X as the first two
+ * tokens, and the #endif closing that #ifndef as the last, with no
+ * #else or #elif of its own, which would make the file say something
+ * when X is defined) and for #pragma once, outside any conditional group.
+ */
+static void FindGuard(IncludeFile *file) {
+    const TokenBuffer *tokens = file->tokens;
+    int n = tokens->NumTokens() - 1;            // leaving out end of input
+    std::string name, guard, define;
+    bool guarded = false;
+    if (n >= 3 && tokens->kinds[0] == T_Directive && tokens->kinds[1] == T_Directive) {
+        const char *p = ReadName(DirectiveText(tokens, 0), name);
+        if (name == "ifndef") {
+            ReadName(p, guard);
+            p = ReadName(DirectiveText(tokens, 1), name);
+            p = ReadName(p, define);
+            guarded = name == "define" && !guard.empty() && define == guard &&
+                      *SkipBlanks(p) == '\0';
+        }
+    }
+
+    int depth = 0;
+    for (int i = 0; i < n; i++) {
+        if (tokens->kinds[i] != T_Directive) continue;
+        std::string word;
+        const char *p = ReadName(DirectiveText(tokens, i), name);
+        if (name == "if" || name == "ifdef" || name == "ifndef")
+            depth++;
+        else if (name == "endif") {
+            if (--depth == 0 && i != n - 1) guarded = false;
+        } else if ((name == "else" || name == "elif") && depth == 1)
+            guarded = false;
+        else if (name == "pragma" && depth == 0) {
+            ReadName(p, word);
+            if (word == "once") file->once = true;
+        }
+    }
+    if (guarded && depth == 0) file->guard = AtomTable::Intern(guard.c_str());
+}
+
+/* Returns the table entry for path, scanning the file on first use (or
+ * if it has changed since), or NULL if it cannot be read; *scanned says
+ * whether it was scanned just now. The file is scanned by a session of
+ * its own so that its lexical errors quote its own lines. They are kept
+ * too, and not added to what the including compilation is recording,
+ * whose locations are in another file.
+ */
+static IncludeFile *LoadInclude(const std::string &path, LexerKind lexer, bool *scanned) {
+    *scanned = false;
+    char *real = realpath(path.c_str(), NULL);
+    if (!real) return NULL;
+    std::string key(real);
+    free(real);
+    struct stat info;
+    if (stat(key.c_str(), &info) < 0) return NULL;
+
+    std::lock_guard<std::mutex> lock(includeLock);
+    std::map<std::string, IncludeFile *>::iterator it = includeTable.find(key);
+    if (it != includeTable.end()) {
+        const IncludeFile *old = it->second;
+        if (old->size == info.st_size && old->modified.tv_sec == info.st_mtim.tv_sec &&
+            old->modified.tv_nsec == info.st_mtim.tv_nsec) {
+            numReused++;
+            return it->second;
+        }
+        PrintDebug("preprocess", "%s has changed, scanning it again", key.c_str());
+    }
+    IncludeFile *file = new IncludeFile;
+    if (!file->source.MapFile(key.c_str())) {
+        delete file;
+        return NULL;
+    }
+    file->path = key;
+    file->size = info.st_size;
+    file->modified = info.st_mtim;
+    file->guard = NULL;
+    file->once = false;
+    file->scan = new ParserSession(&file->source, lexer == L_Stream ? L_Fast : lexer);
+    std::vector<ReportError::Diagnostic> *recording = ReportError::Recording();
+    ReportError::Record(&file->diagnostics);
+    file->scan->LexAhead();
+    ReportError::Record(recording);
+    file->tokens = file->scan->GetTokens();
+    if (file->diagnostics.empty()) {
+        file->tokens = file->scan->TakeTokens();
+        delete file->scan;
+        file->scan = NULL;
+    }
+    FindGuard(file);
+    PrintDebug("preprocess", "Scanned %s: %d tokens%s%s%s", key.c_str(),
+               file->tokens->NumTokens(), file->guard ? ", guard " : "",
+               file->guard ? file->guard : "", file->once ? ", #pragma once" : "");
+    includeTable[key] = file;
+    numScanned++;
+    *scanned = true;
+    return file;
+}
+
+/* Class: ExprEvaluator
+ * --------------------
+ * Evaluates the expression of an #if or #elif, by precedence climbing
+ * over its text.
+ */
+class ExprEvaluator
+{
+  protected:
+    Preprocessor *pp;
+    const char *p;
+    yyltype *loc;
+    int depth;
+    bool failed;
+
+    void Blanks() {
+        while (true) {
+            p = SkipBlanks(p);
+            if (p[0] == '/' && p[1] == '/') p += strlen(p);
+            else if (p[0] == '/' && p[1] == '*') {
+                const char *close = strstr(p + 2, "*/");
+                p = close ? close + 2 : p + strlen(p);
+            } else
+                break;
+        }
+    }
+    void Fail(const char *message) {
+        if (!failed) ReportError::Formatted(loc, "%s in #if expression", message);
+        failed = true;
+    }
+    long Primary();
+    long Binary(int minPrecedence);
+
+  public:
+    ExprEvaluator(Preprocessor *pp, const char *text, yyltype *loc, int depth)
+        : pp(pp), p(text), loc(loc), depth(depth), failed(false) {}
+    long Evaluate() {
+        long value = Binary(1);
+        Blanks();
+        if (*p) Fail("Unexpected text");
+        return failed ? 0 : value;
+    }
+};
+
+/* Returns the precedence of the binary operator at p (0 if there is
+ * none) and its length in len.
+ */
+static int BinaryPrecedence(const char *p, int *len) {
+    static const struct { const char *op; int precedence; } ops[] = {
+        { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 },
+        { ">=", 7 }, { "<<", 8 }, { ">>", 8 }, { "|", 3 }, { "^", 4 },
+        { "&", 5 }, { "<", 7 }, { ">", 7 }, { "+", 9 }, { "-", 9 },
+        { "*", 10 }, { "/", 10 }, { "%", 10 },
+    };
+    for (int i = 0; i < sizeof(ops)/sizeof(*ops); i++) {
+        *len = strlen(ops[i].op);
+        if (!strncmp(p, ops[i].op, *len)) return ops[i].precedence;
+    }
+    return 0;
+}
+
+long ExprEvaluator::Binary(int minPrecedence) {
+    long left = Primary();
+    while (!failed) {
+        Blanks();
+        int len, precedence = BinaryPrecedence(p, &len);
+        if (precedence < minPrecedence) break;
+        const char *op = p;
+        p += len;
+        long right = Binary(precedence + 1);
+        switch (op[0]) {
+          case '|': left = (len == 2) ? (left || right) : (left | right); break;
+          case '&': left = (len == 2) ? (left && right) : (left & right); break;
+          case '^': left ^= right; break;
+          case '=': left = (left == right); break;
+          case '!': left = (left != right); break;
+          case '<': left = (len == 1) ? (left < right) : (op[1] == '=') ?
+                           (left <= right) : (left << right); break;
+          case '>': left = (len == 1) ? (left > right) : (op[1] == '=') ?
+                           (left >= right) : (left >> right); break;
+          case '+': left += right; break;
+          case '-': left -= right; break;
+          case '*': left *= right; break;
+          case '/': case '%':
+            if (right == 0) {
+                Fail("Division by zero");
+                return 0;
+            }
+            left = (op[0] == '/') ? left / right : left % right;
+            break;
+        }
+    }
+    return left;
+}
+
+long ExprEvaluator::Primary() {
+    Blanks();
+    switch (*p) {
+      case '!': p++; return !Primary();
+      case '~': p++; return ~Primary();
+      case '-': p++; return -Primary();
+      case '+': p++; return Primary();
+      case '(': {
+        p++;
+        long value = Binary(1);
+        Blanks();
+        if (*p != ')') Fail("Missing ')'");
+        else p++;
+        return value;
+      }
+    }
+    if (*p >= '0' && *p <= '9') {
+        char *end;
+        long value = strtol(p, &end, 0);
+        p = end;
+        while (*p == 'u' || *p == 'U') p++;
+        return value;
+    }
+
+    std::string name;
+    p = ReadName(p, name);
+    if (name.empty()) {
+        Fail(*p ? "Unexpected character" : "Missing operand");
+        return 0;
+    }
+    if (name == "defined") {
+        Blanks();
+        bool paren = (*p == '(');
+        if (paren) p++;
+        p = ReadName(p, name);
+        Blanks();
+        if (name.empty() || (paren && *p++ != ')')) {
+            Fail("Bad defined()");
+            return 0;
+        }
+        return pp->macros.count(AtomTable::Intern(name.c_str())) != 0;
+    }
+    std::unordered_map<Atom, Preprocessor::Macro>::iterator it =
+        pp->macros.find(AtomTable::Intern(name.c_str()));
+    if (it == pp->macros.end() || it->second.function) return 0;
+    if (depth >= MaxMacroDepth) {
+        Fail("Macros nested too deeply");
+        return 0;
+    }
+    ExprEvaluator inner(pp, it->second.text.c_str(), loc, depth + 1);
+    long value = inner.Evaluate();
+    failed = failed || inner.failed;
+    return value;
+}
+
+Preprocessor::Preprocessor(ParserSession *session) {
+    this->session = session;
+    dir = ".";
+    rewrites = 0;
+    includeErrors = 0;
+}
+
+void Preprocessor::SetFileName(const char *path) {
+    dir = DirName(path);
+}
+
+void Preprocessor::SetIncludePath(const char *dirs) {
+    includePath.clear();
+    while (*dirs) {
+        const char *colon = strchr(dirs, ':');
+        if (!colon) colon = dirs + strlen(dirs);
+        if (colon > dirs) includePath.push_back(std::string(dirs, colon));
+        dirs = *colon ? colon + 1 : colon;
+    }
+}
+
+void Preprocessor::PrintStats() {
+    PrintDebug("preprocess", "%lu files scanned, %lu includes reused, "
+               "%lu skipped by guard or #pragma once", numScanned.load(),
+               numReused.load(), numSkipped.load());
+}
+
+int Preprocessor::NextToken(YYSTYPE *lval, yyltype *loc) {
+    while (true) {
+        int token = Read(lval, loc);
+        if (token == T_Directive) {
+            rewrites++;
+            Directive(lval->identifier, loc);
+            continue;
+        }
+        if (token == 0) {
+            if (!conditions.empty())
+                ReportError::Formatted(NULL, "Input ends inside #if");
+            conditions.clear();
+            return 0;
+        }
+        if (Skipping()) {
+            rewrites++;
+            continue;
+        }
+        if (token == T_Identifier && !macros.empty() && Expand(lval->identifier, loc)) {
+            rewrites++;
+            continue;
+        }
+        return token;
+    }
+}
+
+/* Takes the next token from what was given back, the innermost include
+ * or expansion, or else the session's lexer. Only the last is not a
+ * rewrite.
+ */
+int Preprocessor::Read(YYSTYPE *lval, yyltype *loc) {
+    if (!pushback.empty()) {
+        rewrites++;
+        PPToken &t = pushback.back();
+        int kind = t.kind;
+        *lval = t.value;
+        *loc = t.loc;
+        pushback.pop_back();
+        return kind;
+    }
+    while (!frames.empty()) {
+        Frame &f = frames.back();
+        if (f.file) {
+            if (f.next < f.file->tokens->NumTokens() - 1) {
+                int kind = f.file->tokens->Fetch(f.next++, lval, loc);
+                *loc = f.loc;
+                rewrites++;
+                return kind;
+            }
+            if (conditions.size() > f.conditions) {
+                ReportError::Formatted(&f.loc, "Included file ends inside #if");
+                conditions.resize(f.conditions);
+            }
+        } else if (f.next < f.tokens.size()) {
+            const PPToken &t = f.tokens[f.next++];
+            *lval = t.value;
+            *loc = t.loc;
+            rewrites++;
+            return t.kind;
+        }
+        frames.pop_back();
+    }
+    return session->RawToken(lval, loc);
+}
+
+void Preprocessor::Directive(const char *text, yyltype *loc) {
+    std::string name;
+    const char *rest = SkipBlanks(ReadName(text, name));
+    if (name == "if" || name == "ifdef" || name == "ifndef" ||
+        name == "elif" || name == "else" || name == "endif") {
+        Conditional(name, rest, loc);
+        return;
+    }
+    if (Skipping()) return;
+
+    if (name == "define")
+        Define(rest, loc);
+    else if (name == "undef") {
+        std::string macro;
+        ReadName(rest, macro);
+        if (macro.empty())
+            ReportError::Formatted(loc, "Missing macro name after #undef");
+        else
+            macros.erase(AtomTable::Intern(macro.c_str()));
+    } else if (name == "include")
+        Include(rest, loc);
+    else if (name == "error")
+        ReportError::Formatted(loc, "#error %s", rest);
+    else if (name != "pragma" && name != "version" && name != "extension" &&
+             name != "line" && !(name.empty() && *rest == '\0'))
+        ReportError::Formatted(loc, "Unknown preprocessor directive #%s", text);
+}
+
+/* Carries out #if, #ifdef, #ifndef, #elif, #else and #endif. In a
+ * group that is being skipped, a nested group is skipped whatever its
+ * condition (which is not evaluated). An included file cannot close a
+ * group opened outside it.
+ */
+void Preprocessor::Conditional(const std::string &name, const char *rest,
+                               yyltype *loc) {
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+        bool outer = !Skipping(), value = false;
+        if (outer && name == "if")
+            value = Evaluate(rest, loc) != 0;
+        else if (outer) {
+            std::string macro;
+            ReadName(rest, macro);
+            if (macro.empty())
+                ReportError::Formatted(loc, "Missing macro name after #%s", name.c_str());
+            value = macros.count(AtomTable::Intern(macro.c_str())) == (name == "ifdef");
+        }
+        Condition c = { outer && value, value, false, outer };
+        conditions.push_back(c);
+        return;
+    }
+
+    size_t first = 0;                   // groups opened in an outer file
+    for (size_t i = frames.size(); i-- > 0; )
+        if (frames[i].file) {
+            first = frames[i].conditions;
+            break;
+        }
+    if (conditions.size() <= first) {
+        ReportError::Formatted(loc, "#%s without #if", name.c_str());
+        return;
+    }
+    Condition &c = conditions.back();
+    if (name == "endif") {
+        conditions.pop_back();
+        return;
+    }
+    if (c.sawElse) {
+        ReportError::Formatted(loc, "#%s after #else", name.c_str());
+        return;
+    }
+    if (name == "else") {
+        c.sawElse = true;
+        c.active = c.outerActive && !c.taken;
+        c.taken = true;
+        return;
+    }
+    c.active = c.outerActive && !c.taken && Evaluate(rest, loc) != 0;
+    c.taken = c.taken || c.active;
+}
+
+long Preprocessor::Evaluate(const char *expr, yyltype *loc) {
+    ExprEvaluator evaluator(this, expr, loc, 0);
+    return evaluator.Evaluate();
+}
+
+void Preprocessor::Define(const char *rest, yyltype *loc) {
+    std::string name;
+    const char *p = ReadName(rest, name);
+    if (name.empty()) {
+        ReportError::Formatted(loc, "Missing macro name after #define");
+        return;
+    }
+    Macro m;
+    m.function = (*p == '(');           // no space before the '('
+    if (m.function) {
+        p++;
+        while (*(p = SkipBlanks(p)) != ')') {
+            std::string param;
+            p = SkipBlanks(ReadName(p, param));
+            if (param.empty() || (*p != ',' && *p != ')')) {
+                ReportError::Formatted(loc, "Bad parameter list for macro %s", name.c_str());
+                return;
+            }
+            m.params.push_back(AtomTable::Intern(param.c_str()));
+            if (*p == ',') p++;
+        }
+        p++;
+    }
+    m.text = SkipBlanks(p);
+
+    // The replacement list is scanned like a source of its own
+    SourceBuffer body;
+    body.CopyText(m.text.data(), m.text.size());
+    FastLexer lexer(&body);
+    PPToken t;
+    while ((t.kind = lexer.NextToken(&t.value, &t.loc)) != 0) {
+        if (t.kind == T_Directive)
+            ReportError::Formatted(loc, "'#' is not supported in macro %s", name.c_str());
+        else
+            m.body.push_back(t);
+    }
+    macros[AtomTable::Intern(name.c_str())] = m;
+}
+
+void Preprocessor::Include(const char *rest, yyltype *loc) {
+    char close = (*rest == '"') ? '"' : (*rest == '<') ? '>' : 0;
+    const char *stop = close ? strchr(rest + 1, close) : NULL;
+    if (!stop) {
+        ReportError::Formatted(loc, "Expected \"file\" or <file> after #include");
+        return;
+    }
+    std::string name(rest + 1, stop);
+
+    const std::string *from = &dir;
+    int depth = 0;
+    for (size_t i = frames.size(); i-- > 0; )
+        if (frames[i].file) {
+            if (depth++ == 0) from = &frames[i].dir;
+        }
+    if (depth >= MaxIncludeDepth) {
+        ReportError::Formatted(loc, "#include nested too deeply");
+        return;
+    }
+
+    IncludeFile *file = NULL;
+    bool scanned;
+    if (name[0] == '/')
+        file = LoadInclude(name, session->GetLexerKind(), &scanned);
+    else {
+        file = LoadInclude(*from + "/" + name, session->GetLexerKind(), &scanned);
+        for (size_t i = 0; !file && i < includePath.size(); i++)
+            file = LoadInclude(includePath[i] + "/" + name, session->GetLexerKind(), &scanned);
+    }
+    if (!file) {
+        ReportError::Formatted(loc, "Cannot open include file '%s'", name.c_str());
+        return;
+    }
+    if ((file->guard && macros.count(file->guard)) ||
+        (file->once && included.count(file))) {
+        numSkipped++;
+        return;
+    }
+    if (file->once) included.insert(file);
+    if (!file->diagnostics.empty() && !reported.count(file)) {
+        reported.insert(file);
+        includeErrors += file->diagnostics.size();
+        if (!scanned) ReplayScanErrors(file);
+    }
+
+    Frame f;
+    f.file = file;
+    f.next = 0;
+    f.macro = NULL;
+    f.loc = *loc;
+    f.conditions = conditions.size();
+    f.dir = DirName(file->path);
+    frames.push_back(f);
+}
+
+/* Reports the lexical errors found when file was scanned, in a
+ * compilation that did not scan it (and so has not seen them), once.
+ * They quote the file's lines through the session that scanned it,
+ * which only one thread can do at a time. They are not recorded with
+ * the compilation's own, whose locations are in another file.
+ */
+void Preprocessor::ReplayScanErrors(const IncludeFile *file) {
+    std::vector<ReportError::Diagnostic> *recording = ReportError::Recording();
+    ReportError::Record(NULL);
+    {
+        std::lock_guard<std::mutex> lock(includeLock);
+        file->scan->Replay(file->diagnostics, file->tokens);
+    }
+    ReportError::Record(recording);
+}
+
+/* Expands the macro name, if it is one and is not already being
+ * expanded, by pushing its expansion as the next input. A function-like
+ * macro is only called if a '(' comes next. Returns whether the name
+ * was taken up (by an expansion, or by a call in error).
+ */
+bool Preprocessor::Expand(Atom name, yyltype *loc) {
+    std::unordered_map<Atom, Macro>::iterator it = macros.find(name);
+    if (it == macros.end()) return false;
+    for (size_t i = 0; i < frames.size(); i++)
+        if (frames[i].macro == name) return false;
+    const Macro &m = it->second;
+    yyltype at = *loc;
+
+    Frame f;
+    f.file = NULL;
+    f.next = 0;
+    f.macro = name;
+    f.loc = at;
+    f.conditions = conditions.size();
+    if (!m.function)
+        f.tokens = m.body;
+    else {
+        PPToken next;
+        next.kind = Read(&next.value, &next.loc);
+        if (next.kind != T_LeftParen) {
+            pushback.push_back(next);
+            return false;
+        }
+        std::vector<std::vector<PPToken> > args;
+        if (!ReadArguments(m, name, &at, args)) return true;
+        for (size_t i = 0; i < m.body.size(); i++) {
+            const PPToken &t = m.body[i];
+            size_t param = m.params.size();
+            if (t.kind == T_Identifier)
+                for (param = 0; param < m.params.size(); param++)
+                    if (m.params[param] == t.value.identifier) break;
+            if (param < m.params.size())
+                f.tokens.insert(f.tokens.end(), args[param].begin(), args[param].end());
+            else
+                f.tokens.push_back(t);
+        }
+    }
+    for (size_t i = 0; i < f.tokens.size(); i++)
+        f.tokens[i].loc = at;
+    frames.push_back(f);
+    return true;
+}
+
+/* Reads the arguments of a call of m, the '(' already read: token
+ * lists split at the commas outside any nested parentheses.
+ */
+bool Preprocessor::ReadArguments(const Macro &m, Atom name, yyltype *loc,
+                                 std::vector<std::vector<PPToken> > &args) {
+    args.assign(1, std::vector<PPToken>());
+    int depth = 0;
+    while (true) {
+        PPToken t;
+        t.kind = Read(&t.value, &t.loc);
+        if (t.kind == 0) {
+            ReportError::Formatted(loc, "Input ends in the arguments of macro %s", name);
+            pushback.push_back(t);
+            return false;
+        }
+        if (t.kind == T_Directive) {
+            ReportError::Formatted(&t.loc, "Directive in the arguments of macro %s", name);
+            continue;
+        }
+        if (t.kind == T_LeftParen)
+            depth++;
+        else if (t.kind == T_RightParen && depth-- == 0)
+            break;
+        else if (t.kind == T_Comma && depth == 0) {
+            args.push_back(std::vector<PPToken>());
+            continue;
+        }
+        args.back().push_back(t);
+    }
+    if (m.params.empty() && args.size() == 1 && args[0].empty()) args.clear();
+    if (args.size() != m.params.size()) {
+        ReportError::Formatted(loc, "Macro %s takes %d arguments, not %d", name,
+                               (int)m.params.size(), (int)args.size());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+/* File: preprocess.h
+ * ------------------
+ * The preprocessor sits between the lexer and the parser. Both lexers
+ * hand over a line that starts with '#' as a single T_Directive token
+ * whose value is the text after the '#'; the preprocessor carries those
+ * out and passes every other token on, expanding macros as it goes:
+ *
+ *   #define NAME tokens          #undef NAME
+ *   #define NAME(a, b) tokens    #include "file" / <file>
+ *   #ifdef, #ifndef, #if, #elif, #else, #endif
+ *   #pragma once                 #error message
+ *
+ * #version, #extension, #line and other #pragmas are accepted and
+ * ignored. Macros work on tokens: a replacement list is scanned once,
+ * when the #define is seen, and an expansion is rescanned for further
+ * macros with the macro itself turned off. There are no # or ##
+ * operators. #if takes C integer expressions, with defined(NAME), and
+ * macros that expand to one; any other identifier is 0. Tokens in a
+ * skipped group have been scanned like any other (only not passed on),
+ * so lexical errors in them are still reported.
+ *
+ * Included files are scanned once per process, into a TokenBuffer kept
+ * in a table shared by all compilations, and every later #include of
+ * the same file reads those tokens. When a file is scanned it is also
+ * checked for an include guard (#ifndef X / #define X first, the
+ * matching #endif last) and for #pragma once; an #include of a file
+ * whose guard macro is defined, or of a #pragma once file already
+ * included by this compilation, is skipped without reading its tokens
+ * at all. Quoted and bracketed names are both looked for next to the
+ * including file first, then in each directory of the include path.
+ * A file whose size or modification time has changed is scanned again.
+ * Lexical errors in an included file are reported (and counted) in
+ * every compilation that reads its tokens, not only the one that
+ * happened to scan it.
+ *
+ * Tokens from an included file or a macro expansion carry the location
+ * of the #include or of the macro's name, since a location cannot name
+ * another file.
+ */
+
+#ifndef _H_preprocess
+#define _H_preprocess
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "parser.h"
+
+struct IncludeFile;
+
+class Preprocessor
+{
+  public:
+    struct PPToken {
+        int kind;
+        YYSTYPE value;
+        yyltype loc;
+    };
+
+    struct Macro {
+        bool function;                  // takes arguments
+        std::vector<Atom> params;
+        std::vector<PPToken> body;
+        std::string text;               // the replacement list, for #if
+    };
+    typedef std::unordered_map<Atom, Macro> MacroTable;
+
+  protected:
+    struct Condition {                  // one #if ... #endif group
+        bool active;                    // tokens in this branch are kept
+        bool taken;                     // some branch has been kept
+        bool sawElse;
+        bool outerActive;               // the enclosing group is kept
+    };
+
+    struct Frame {                      // an include or macro expansion
+        const IncludeFile *file;        // NULL for a macro
+        std::vector<PPToken> tokens;    // the expansion, for a macro
+        size_t next;
+        Atom macro;                     // the macro expanded, turned off
+        yyltype loc;                    // what its tokens are located at
+        size_t conditions;              // group depth where the file began
+        std::string dir;                // the file's directory
+    };
+
+    ParserSession *session;
+    MacroTable macros;
+    std::vector<Condition> conditions;
+    std::vector<Frame> frames;
+    std::vector<PPToken> pushback;      // tokens read ahead and given back
+    std::unordered_set<const IncludeFile *> included;    // #pragma once files
+    std::unordered_set<const IncludeFile *> reported;    // whose errors are out
+    int includeErrors;                  // lexical errors in included files
+    std::string dir;                    // the main file's directory
+    unsigned long rewrites;             // see NumRewrites()
+
+    int Read(YYSTYPE *lval, yyltype *loc);
+    void Directive(const char *text, yyltype *loc);
+    void Conditional(const std::string &name, const char *rest, yyltype *loc);
+    void Define(const char *rest, yyltype *loc);
+    void Include(const char *rest, yyltype *loc);
+    void ReplayScanErrors(const IncludeFile *file);
+    bool Expand(Atom name, yyltype *loc);
+    bool ReadArguments(const Macro &m, Atom name, yyltype *loc,
+                       std::vector<std::vector<PPToken> > &args);
+    long Evaluate(const char *expr, yyltype *loc);
+    bool Skipping() { return !conditions.empty() && !conditions.back().active; }
+
+  public:
+    Preprocessor(ParserSession *session);
+
+        // Names the file being compiled, so #include "x" can look next
+        // to it (without one, the current directory)
+    void SetFileName(const char *path);
+
+        // The next token for the parser, with directives carried out and
+        // macros expanded; 0 at the end of the input
+    int NextToken(YYSTYPE *lval, yyltype *loc);
+
+        // The macros defined so far, and a way to start out with some
+        // already defined (a prelude's) rather than none
+    const MacroTable &GetMacros()   { return macros; }
+    void SetMacros(const MacroTable &table) { macros = table; }
+
+        // How often it has done more than pass on the next token the
+        // session scanned: carried out a directive, skipped a token,
+        // expanded a macro, or read from an include, an expansion or
+        // what it gave back. If this is the same after a run of tokens
+        // as before, they are just what was scanned from their text.
+    unsigned long NumRewrites()     { return rewrites; }
+
+        // The lexical errors in the files this compilation included,
+        // which were reported in it but are not in its own tokens
+    int NumIncludeErrors()          { return includeErrors; }
+
+        // Directories (separated by ':') to search for included files,
+        // after the including file's own (the -include-path= option)
+    static void SetIncludePath(const char *dirs);
+
+        // Prints the include table's use (debug key "preprocess")
+    static void PrintStats();
+
+    friend class ExprEvaluator;
+};
+
+#endif
@@ -0,0 +1,641 @@
+/* File: rdparse.cc
+ * ----------------
+ * Implementation of the hand-written parser. Each Parse method stands
+ * in for one or more rules of parser.y, named in its comment, and
+ * builds what their actions build. There is always a lookahead token:
+ * a method is called with the first token of what it parses in token,
+ * and returns with the first token after it there.
+ *
+ * Where an action in parser.y uses yylloc, the location is the one
+ * bison had when it reduced. If the rule ends in a token after which
+ * there is nothing to decide (the ')' of a function's parameters, the
+ * ';' of a break, a constant), bison reduces without reading ahead and
+ * yylloc is that token: here prevLoc, since the lookahead has moved on.
+ * If it ends in a symbol that needs a look at the next token to finish
+ * (an identifier that might be a call, an expression that might go on),
+ * yylloc is the lookahead: here loc.
+ *
+ * After a syntax error, which has been reported, failed is set and a
+ * method returns NULL; every caller checks failed after each call and
+ * returns too, so the parse stops there. (A NULL result alone means
+ * nothing: nothing at all is built when build is off.)
+ */
+
+#include "rdparse.h"
+#include "errors.h"
+#include "utility.h"
+#include "arena.h"
+
+/* The binary operators by precedence, loosest first, one level for
+ * each of LogicOrExpr up to MultiExpr. All are left associative.
+ */
+enum Precedence { Prec_None, Prec_Or, Prec_And, Prec_Equality, Prec_Relation, Prec_Addition, Prec_Multi };
+
+static int PrecedenceOf(int token)
+{
+    switch (token) {
+      case T_Star: case T_Slash:                        return Prec_Multi;
+      case T_Plus: case T_Dash:                         return Prec_Addition;
+      case T_LeftAngle: case T_RightAngle:
+      case T_GreaterEqual: case T_LessEqual:            return Prec_Relation;
+      case T_EQ: case T_NE:                             return Prec_Equality;
+      case T_And:                                       return Prec_And;
+      case T_Or:                                        return Prec_Or;
+      default:                                          return Prec_None;
+    }
+}
+
+/* The spelling an AssignOp gives its Operator, or NULL if the token is
+ * not one. T_Equal's is its own value.
+ */
+static const char *AssignSpelling(int token, const YYSTYPE &lval)
+{
+    switch (token) {
+      case T_Equal:     return lval.identifier;
+      case T_AddAssign: return "+=";
+      case T_SubAssign: return "-=";
+      case T_MulAssign: return "*=";
+      case T_DivAssign: return "/=";
+      default:          return NULL;
+    }
+}
+
+static bool IsTypeQualifier(int token)
+{
+    return token == T_In || token == T_Out || token == T_Const || token == T_Uniform;
+}
+
+static bool IsType(int token)
+{
+    switch (token) {
+      case T_Int: case T_Void: case T_Float: case T_Uint: case T_Bool:
+      case T_Vec2: case T_Vec3: case T_Vec4:
+      case T_Mat2: case T_Mat3: case T_Mat4:
+        return true;
+      default:
+        return false;
+    }
+}
+
+RDParser::RDParser(ParserSession *s, bool build)
+{
+    session = s;
+    this->build = build;
+    lazyBodies = build && s && s->GetLazyBodies() && s->GetSource();
+    replay = NULL;
+    replayNext = 0;
+    token = 0;
+    loc = prevLoc = yyltype();
+    failed = false;
+    depth = 0;
+}
+
+void RDParser::Advance()
+{
+    prevLoc = loc;
+    if (!replay) {
+        token = session->NextToken(&lval, &loc);
+    } else if (replayNext < replay->size()) {
+        const Preprocessor::PPToken &t = (*replay)[replayNext++];
+        token = t.kind;
+        lval = t.value;
+        loc = t.loc;
+    } else {
+        token = 0;
+    }
+}
+
+bool RDParser::Accept(int t)
+{
+    if (token != t) return false;
+    Advance();
+    return true;
+}
+
+bool RDParser::Expect(int t)
+{
+    if (Accept(t)) return true;
+    SyntaxError();
+    return false;
+}
+
+/* As yyerror() reports it: at the lookahead, which cannot go on. The
+ * NULL it returns is for the caller to return.
+ */
+std::nullptr_t RDParser::SyntaxError()
+{
+    if (!failed) ReportError::Formatted(&loc, "syntax error");
+    failed = true;
+    return NULL;
+}
+
+/* Nesting is limited, since it costs stack here; bison's own limit is
+ * 10000 entries on its stack, which is not the same depth of nesting,
+ * so the two give up on different inputs, both with this message.
+ */
+bool RDParser::Enter()
+{
+    if (++depth <= MaxDepth) return true;
+    if (!failed) ReportError::Formatted(&loc, "memory exhausted");
+    failed = true;
+    return false;
+}
+
+/* Program, DeclList. After a declaration, a token that cannot start
+ * another one ends the DeclList: bison reduces Program there by
+ * default, whatever the token, and so runs its action (which checks
+ * the program) before it finds that the token is not the end of the
+ * input. The syntax error comes after the check's output here too.
+ */
+bool RDParser::Parse()
+{
+    PrintDebug("parser", "Parsing by recursive descent%s",
+               build ? "" : ", building nothing");
+    Advance();
+    List<Decl*> *decls = New<List<Decl*> >();
+    do {
+        Decl *decl = ParseDecl();
+        if (failed) return false;
+        Add(decls, decl);
+    } while (IsTypeQualifier(token) || IsType(token));
+    if (build && !session->FinishProgram(new Program(decls))) return false;
+    if (token == 0) return true;
+    SyntaxError();
+    return false;
+}
+
+/* Decl, Declaration, FuncDecl: a function prototype or definition, or
+ * a variable. Only a variable can have a qualifier; otherwise the '('
+ * after the name is what tells them apart.
+ */
+Decl *RDParser::ParseDecl()
+{
+    if (IsTypeQualifier(token)) {
+        VarDecl *var = ParseSingleDecl();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        return var;
+    }
+    yyltype typeLoc = loc;
+    Type *type = ParseType();
+    if (failed) return NULL;
+    if (token != T_Identifier) return SyntaxError();
+    Atom name = lval.identifier;
+    yyltype nameLoc = loc;
+    Advance();
+    if (token != T_LeftParen) {
+        VarDecl *var = FinishSingleDecl(NULL, type, typeLoc, name, nameLoc);
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        return var;
+    }
+
+    Advance();
+    List<VarDecl*> *formals;
+    if (token == T_RightParen) formals = New<List<VarDecl*> >();
+    else if (formals = ParseParameters(), failed) return NULL;
+    if (!Expect(T_RightParen)) return NULL;
+    FnDecl *fn = New<FnDecl>(New<Identifier>(prevLoc, name), type, formals);
+    if (Accept(T_Semicolon)) return fn;
+    if (token != T_LeftBrace) return SyntaxError();
+    Stmt *body = lazyBodies ? SkipBody() : ParseCompoundStatement();
+    if (failed) return NULL;
+    if (fn) fn->SetFunctionBody(body);
+    return fn;
+}
+
+/* A function body, left for later: its tokens are read up to the
+ * matching '}' and kept meanwhile (in the one vector, reused), and only
+ * a syntax error at the end of the input is reported. If they are just
+ * what was scanned from the body's text, scanning that again gives them
+ * back, so a LazyBody saying where the text is does for the body.
+ * Otherwise the preprocessor made them (in part), and they are parsed
+ * now, as they are.
+ */
+Stmt *RDParser::SkipBody()
+{
+    Preprocessor *preprocessor = session->GetPreprocessor();
+    unsigned long rewrites = preprocessor->NumRewrites();
+    yyltype open = loc;
+    skipped.clear();
+    int nesting = 0;
+    while (true) {
+        if (token == 0) return SyntaxError();
+        Preprocessor::PPToken t = { token, lval, loc };
+        skipped.push_back(t);
+        if (token == T_LeftBrace) nesting++;
+        else if (token == T_RightBrace && --nesting == 0) break;
+        Advance();
+    }
+    yyltype text = Join(open, loc);
+    bool scanned = preprocessor->NumRewrites() == rewrites &&
+                   session->GetSource()->GetBase()[open.offset] == '{';
+    Advance();
+    if (scanned) return new LazyBody(text, session->GetSource(), session->GetArena());
+
+    Stmt *body = RDParser(NULL).ParseBody(skipped);
+    if (!body) failed = true;
+    return body;
+}
+
+Stmt *RDParser::ParseBody(const std::vector<Preprocessor::PPToken> &tokens)
+{
+    replay = &tokens;
+    replayNext = 0;
+    Advance();
+    Stmt *body = ParseCompoundStatement();
+    return failed ? NULL : body;
+}
+
+/* Scanned with a FastLexer whatever lexer the session used, since that
+ * is the one that can start anywhere; the two scan alike.
+ */
+Stmt *LazyBody::Parse()
+{
+    PrintDebug("parser", "Parsing the body at line %d, bytes %u+%u",
+               location.line, location.offset, location.length);
+    std::vector<Preprocessor::PPToken> tokens;
+    FastLexer lexer(source);
+    lexer.ScanRange(location.offset, location.length, location.line);
+    Preprocessor::PPToken t;
+    t.loc = location;
+    while ((t.kind = lexer.NextToken(&t.value, &t.loc)) != 0)
+        tokens.push_back(t);
+    Arena *saved = Arena::SetCurrent(arena);
+    Stmt *body = RDParser(NULL).ParseBody(tokens);
+    Arena::SetCurrent(saved);
+    return body;
+}
+
+/* ParameterList */
+List<VarDecl*> *RDParser::ParseParameters()
+{
+    List<VarDecl*> *formals = New<List<VarDecl*> >();
+    do {
+        VarDecl *formal = ParseSingleDecl();
+        if (failed) return NULL;
+        Add(formals, formal);
+    } while (Accept(T_Comma));
+    return formals;
+}
+
+/* SingleDecl */
+VarDecl *RDParser::ParseSingleDecl()
+{
+    TypeQualifier *typeq = ParseTypeQualifier();
+    yyltype typeLoc = loc;
+    Type *type = ParseType();
+    if (failed) return NULL;
+    if (token != T_Identifier) return SyntaxError();
+    Atom name = lval.identifier;
+    yyltype nameLoc = loc;
+    Advance();
+    return FinishSingleDecl(typeq, type, typeLoc, name, nameLoc);
+}
+
+/* The rest of a SingleDecl, after its name: an array size, an
+ * initializer or neither. An array's name has its own location; the
+ * others get the lookahead after the declaration.
+ */
+VarDecl *RDParser::FinishSingleDecl(TypeQualifier *typeq, Type *type,
+                                    yyltype typeLoc, Atom name, yyltype nameLoc)
+{
+    if (Accept(T_LeftBracket)) {
+        if (token != T_IntConstant) return SyntaxError();
+        int count = lval.integerConstant;
+        Advance();
+        if (!Expect(T_RightBracket)) return NULL;
+        Identifier *id = New<Identifier>(nameLoc, name);
+        Type *array = New<ArrayType>(typeLoc, type, count);
+        return typeq ? New<VarDecl>(id, array, typeq) : New<VarDecl>(id, array);
+    }
+    Expr *init = NULL;
+    if (Accept(T_Equal) && (init = ParseExpression(), failed)) return NULL;
+    Identifier *id = New<Identifier>(loc, name);
+    return typeq ? New<VarDecl>(id, type, typeq, init) : New<VarDecl>(id, type, init);
+}
+
+/* TypeQualify, which is optional wherever it appears: NULL if the
+ * lookahead is not one
+ */
+TypeQualifier *RDParser::ParseTypeQualifier()
+{
+    TypeQualifier *typeq;
+    switch (token) {
+      case T_In:      typeq = TypeQualifier::inTypeQualifier; break;
+      case T_Out:     typeq = TypeQualifier::outTypeQualifier; break;
+      case T_Const:   typeq = TypeQualifier::constTypeQualifier; break;
+      case T_Uniform: typeq = TypeQualifier::uniformTypeQualifier; break;
+      default:        return NULL;
+    }
+    Advance();
+    return typeq;
+}
+
+/* TypeDecl */
+Type *RDParser::ParseType()
+{
+    Type *type;
+    switch (token) {
+      case T_Int:   type = Type::intType; break;
+      case T_Void:  type = Type::voidType; break;
+      case T_Float: type = Type::floatType; break;
+      case T_Uint:  type = Type::uintType; break;
+      case T_Bool:  type = Type::boolType; break;
+      case T_Vec2:  type = Type::vec2Type; break;
+      case T_Vec3:  type = Type::vec3Type; break;
+      case T_Vec4:  type = Type::vec4Type; break;
+      case T_Mat2:  type = Type::mat2Type; break;
+      case T_Mat3:  type = Type::mat3Type; break;
+      case T_Mat4:  type = Type::mat4Type; break;
+      default:      return SyntaxError();
+    }
+    Advance();
+    return type;
+}
+
+/* CompoundStatement */
+Stmt *RDParser::ParseCompoundStatement()
+{
+    if (!Expect(T_LeftBrace)) return NULL;
+    List<Stmt*> *stmts;
+    if (token == T_RightBrace) stmts = New<List<Stmt*> >();
+    else if (stmts = ParseStatementList(), failed) return NULL;
+    if (!Expect(T_RightBrace)) return NULL;
+    return New<StmtBlock>(New<List<VarDecl*> >(), stmts);
+}
+
+/* StatementList: one statement or more, up to a '}' */
+List<Stmt*> *RDParser::ParseStatementList()
+{
+    List<Stmt*> *stmts = New<List<Stmt*> >();
+    do {
+        Stmt *stmt = ParseStatement();
+        if (failed) return NULL;
+        Add(stmts, stmt);
+    } while (token != T_RightBrace);
+    return stmts;
+}
+
+/* Statement */
+Stmt *RDParser::ParseStatement()
+{
+    if (!Enter()) return NULL;
+    Stmt *stmt = (token == T_LeftBrace) ? ParseCompoundStatement() : ParseSingleStatement();
+    Leave();
+    return stmt;
+}
+
+/* SingleStatement, SelectionStmt, SwitchStmt, CaseStmt, JumpStmt,
+ * WhileStmt and ForStmt. An else goes with the nearest if, as
+ * LOWER_THAN_ELSE has it. Anything that starts no other statement is
+ * taken for an expression.
+ */
+Stmt *RDParser::ParseSingleStatement()
+{
+    if (IsTypeQualifier(token) || IsType(token)) {
+        VarDecl *var = ParseSingleDecl();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        return New<DeclStmt>(var);
+    }
+    switch (token) {
+      case T_Semicolon:
+        Advance();
+        return New<EmptyExpr>();
+
+      case T_If: {
+        Advance();
+        Expr *test = ParseParenthesized();
+        if (failed) return NULL;
+        Stmt *thenBody = ParseStatement();
+        if (failed) return NULL;
+        Stmt *elseBody = NULL;
+        if (Accept(T_Else) && (elseBody = ParseStatement(), failed)) return NULL;
+        return New<IfStmt>(test, thenBody, elseBody);
+      }
+      case T_Switch: {
+        Advance();
+        Expr *expr = ParseParenthesized();
+        if (failed || !Expect(T_LeftBrace)) return NULL;
+        List<Stmt*> *cases = ParseStatementList();
+        if (failed || !Expect(T_RightBrace)) return NULL;
+        return New<SwitchStmt>(expr, cases, (Default *)NULL);
+      }
+      case T_Case: {
+        Advance();
+        Expr *label = ParseExpression();
+        if (failed || !Expect(T_Colon)) return NULL;
+        Stmt *stmt = ParseStatement();
+        return failed ? NULL : New<Case>(label, stmt);
+      }
+      case T_Default: {
+        Advance();
+        if (!Expect(T_Colon)) return NULL;
+        Stmt *stmt = ParseStatement();
+        return failed ? NULL : New<Default>(stmt);
+      }
+
+      case T_Break:
+        Advance();
+        return Expect(T_Semicolon) ? New<BreakStmt>(prevLoc) : NULL;
+      case T_Continue:
+        Advance();
+        return Expect(T_Semicolon) ? New<ContinueStmt>(prevLoc) : NULL;
+      case T_Return: {
+        yyltype start = loc;
+        Advance();
+        if (Accept(T_Semicolon)) return New<ReturnStmt>(prevLoc);
+        Expr *expr = ParseExpression();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        return New<ReturnStmt>(Join(start, prevLoc), expr);
+      }
+
+      case T_While: {
+        Advance();
+        Expr *test = ParseParenthesized();
+        if (failed) return NULL;
+        Stmt *body = ParseStatement();
+        return failed ? NULL : New<WhileStmt>(test, body);
+      }
+      case T_For: {
+        Advance();
+        if (!Expect(T_LeftParen)) return NULL;
+        Expr *init = ParseExpression();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        Expr *test = ParseExpression();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        Expr *step = ParseExpression();
+        if (failed || !Expect(T_RightParen)) return NULL;
+        Stmt *body = ParseStatement();
+        return failed ? NULL : New<ForStmt>(init, test, step, body);
+      }
+
+      default: {
+        Expr *expr = ParseExpression();
+        if (failed || !Expect(T_Semicolon)) return NULL;
+        return expr;
+      }
+    }
+}
+
+/* '(' Expression ')', as the tests of if, switch and while have it */
+Expr *RDParser::ParseParenthesized()
+{
+    if (!Expect(T_LeftParen)) return NULL;
+    Expr *expr = ParseExpression();
+    if (failed || !Expect(T_RightParen)) return NULL;
+    return expr;
+}
+
+/* Expression: an assignment, whose left side can only be a UnaryExpr,
+ * a conditional, whose three parts are LogicOrExprs, or a LogicOrExpr.
+ * Both start with a UnaryExpr, so that is parsed first and what comes
+ * after it decides.
+ */
+Expr *RDParser::ParseExpression()
+{
+    if (!Enter()) return NULL;
+    Expr *result = NULL;
+    Expr *left = ParseUnary();
+    const char *assign = failed ? NULL : AssignSpelling(token, lval);
+    if (assign) {
+        Operator *op = New<Operator>(loc, assign);      // AssignOp's own token
+        Advance();
+        Expr *right = ParseExpression();
+        if (!failed) result = New<AssignExpr>(left, op, right);
+    } else if (!failed && (result = ParseBinary(left, Prec_Or), !failed) &&
+               Accept(T_Question)) {
+        Expr *test = result;
+        result = NULL;
+        Expr *whenTrue = ParseUnary();
+        if (!failed) whenTrue = ParseBinary(whenTrue, Prec_Or);
+        if (!failed && Expect(T_Colon)) {
+            Expr *whenFalse = ParseUnary();
+            if (!failed) whenFalse = ParseBinary(whenFalse, Prec_Or);
+            if (!failed) result = New<ConditionalExpr>(test, whenTrue, whenFalse);
+        }
+    }
+    Leave();
+    return result;
+}
+
+/* MultiExpr up to LogicOrExpr: folds the operators after left that
+ * bind at least as tightly as minPrecedence into it. Each is reduced
+ * when the lookahead after its right operand binds no tighter, and
+ * that lookahead is the Operator's location.
+ */
+Expr *RDParser::ParseBinary(Expr *left, int minPrecedence)
+{
+    int precedence;
+    while ((precedence = PrecedenceOf(token)) >= minPrecedence) {
+        Atom spelling = lval.identifier;
+        Advance();
+        Expr *right = ParseUnary();
+        if (!failed) right = ParseBinary(right, precedence + 1);
+        if (failed) return NULL;
+        Operator *op = New<Operator>(loc, spelling);
+        if (precedence == Prec_Relation) left = New<RelationalExpr>(left, op, right);
+        else left = New<ArithmeticExpr>(left, op, right);
+    }
+    return left;
+}
+
+/* UnaryExpr: the operator's location is the lookahead after the
+ * operand, as with the binary ones
+ */
+Expr *RDParser::ParseUnary()
+{
+    if (token != T_Inc && token != T_Dec && token != T_Plus && token != T_Dash)
+        return ParsePostfix();
+    if (!Enter()) return NULL;
+    Atom spelling = lval.identifier;
+    Advance();
+    Expr *operand = ParseUnary();
+    Expr *result = failed ? NULL : New<ArithmeticExpr>(New<Operator>(loc, spelling), operand);
+    Leave();
+    return result;
+}
+
+/* PostfixExpr. An ArrayAccess is located at the whole of its base, so
+ * that is kept as it grows.
+ */
+Expr *RDParser::ParsePostfix()
+{
+    yyltype span;
+    Expr *expr = ParsePrimary(&span);
+    while (!failed) {
+        switch (token) {
+          case T_LeftBracket: {
+            Advance();
+            Expr *subscript = ParseExpression();
+            if (failed || !Expect(T_RightBracket)) return NULL;
+            expr = New<ArrayAccess>(span, expr, subscript);
+            break;
+          }
+          case T_Inc: case T_Dec:
+            expr = New<PostfixExpr>(expr, New<Operator>(loc, lval.identifier));
+            Advance();
+            break;
+          case T_Dot:
+            Advance();
+            if (token != T_FieldSelection) return SyntaxError();
+            expr = New<FieldAccess>(expr, New<Identifier>(loc, lval.identifier));
+            Advance();
+            break;
+          default:
+            return expr;
+        }
+        span = Join(span, prevLoc);
+    }
+    return NULL;
+}
+
+/* PrimaryExpr, and FunctionCallExpr, which starts the same way; *span
+ * is set to where it is in the source, parentheses and all
+ */
+Expr *RDParser::ParsePrimary(yyltype *span)
+{
+    *span = loc;
+    Expr *expr;
+    switch (token) {
+      case T_Identifier: {
+        Atom name = lval.identifier;
+        Advance();
+        if (token == T_LeftParen) {
+            expr = ParseCall(name, *span);
+            break;
+        }
+        return New<VarExpr>(*span, New<Identifier>(loc, name));
+      }
+      case T_IntConstant:   expr = New<IntConstant>(loc, lval.integerConstant); Advance(); return expr;
+      case T_UintConstant:  expr = New<UintConstant>(loc, lval.uintConstant); Advance(); return expr;
+      case T_FloatConstant: expr = New<FloatConstant>(loc, lval.floatConstant); Advance(); return expr;
+      case T_BoolConstant:  expr = New<BoolConstant>(loc, lval.boolConstant); Advance(); return expr;
+      case T_LeftParen:
+        Advance();
+        expr = ParseExpression();
+        if (failed || !Expect(T_RightParen)) return NULL;
+        break;
+      default:
+        return SyntaxError();
+    }
+    if (!failed) *span = Join(*span, prevLoc);
+    return expr;
+}
+
+/* FunctionCallHeaderNoParameters, FunctionCallHeaderWithParameters
+ * and ArgumentList, from the '(' after the function's name
+ */
+Expr *RDParser::ParseCall(Atom name, yyltype nameLoc)
+{
+    Identifier *id = New<Identifier>(nameLoc, name);
+    Advance();
+    List<Expr*> *args = New<List<Expr*> >();
+    if (!Accept(T_Void) && token != T_RightParen) {
+        do {
+            Expr *arg = ParseExpression();
+            if (failed) return NULL;
+            Add(args, arg);
+        } while (Accept(T_Comma));
+    }
+    if (!Expect(T_RightParen)) return NULL;
+    return New<Call>(nameLoc, (Expr *)NULL, id, args);
+}
@@ -0,0 +1,113 @@
+/* File: rdparse.h
+ * ---------------
+ * A hand-written parser for the same grammar as parser.y, used when the
+ * compiler runs with -parser=rd. Declarations and statements are parsed
+ * by recursive descent, and expressions by precedence climbing (a Pratt
+ * parser): an operand is parsed once and the binary operators after it
+ * are folded in by their precedence, where the bison grammar reduces
+ * every operand through PrimaryExpr, PostfixExpr, UnaryExpr, MultiExpr
+ * and so on up to Expression, a state and a stack entry each.
+ *
+ * RDParser must build exactly the tree the bison parser builds: the
+ * same nodes with the same locations, the same Operator spellings, and
+ * the same "syntax error" at the same token. That includes the places
+ * where the grammar's actions use yylloc, the location of the last
+ * token bison had read when it reduced: for some rules that is the
+ * rule's own last token, for others the lookahead after it (see
+ * rdparse.cc). Like the bison parser it stops at the first syntax
+ * error, and checks the program only if there were no errors at all.
+ * Any change to the rules in parser.y has to be made here too;
+ * astdiff.sh is there to catch the ones that weren't.
+ *
+ * It reads tokens from the session as yyparse does, through
+ * ParserSession::NextToken() and so through the preprocessor, so every
+ * lexer and token mode works with it. Feed() always uses the bison
+ * parser, whose push form is what makes a token at a time possible.
+ *
+ * It can also leave function bodies for later (see
+ * ParserSession::SetLazyBodies): a body is skipped by matching its
+ * braces, and a LazyBody records where its text is. Parsing it later
+ * takes a parser of its own, reading the body's tokens scanned again
+ * from that text rather than from a session.
+ */
+
+#ifndef _H_rdparse
+#define _H_rdparse
+
+#include <cstddef>
+#include <vector>
+#include "parser.h"
+#include "preprocess.h"
+
+class RDParser
+{
+  protected:
+    static const int MaxDepth = 5000;   // nesting, before giving up
+
+    ParserSession *session;
+    int token;                          // the lookahead,
+    YYSTYPE lval;                       // its value
+    yyltype loc;                        // and location
+    yyltype prevLoc;                    // the location of the token before it
+    bool failed;                        // a syntax error has been reported
+    int depth;                          // statements and expressions open
+    bool build;                         // else it only recognizes the input
+    bool lazyBodies;                    // function bodies are skipped
+    const std::vector<Preprocessor::PPToken> *replay;  // read instead of
+    size_t replayNext;                  // the session's tokens, if not NULL
+    std::vector<Preprocessor::PPToken> skipped;        // the body last skipped
+
+        // A new T, or NULL if nothing is being built
+    template <class T, class... Args> T *New(Args... args) {
+        return build ? new T(args...) : NULL;
+    }
+    template <class T> static void Add(List<T> *list, T elem) {
+        if (list) list->Append(elem);
+    }
+
+    void Advance();
+    bool Accept(int t);
+    bool Expect(int t);
+    std::nullptr_t SyntaxError();
+    bool Enter();
+    void Leave()                        { depth--; }
+
+    Decl *ParseDecl();
+    VarDecl *ParseSingleDecl();
+    VarDecl *FinishSingleDecl(TypeQualifier *typeq, Type *type,
+                              yyltype typeLoc, Atom name, yyltype nameLoc);
+    List<VarDecl*> *ParseParameters();
+    TypeQualifier *ParseTypeQualifier();
+    Type *ParseType();
+    Stmt *ParseCompoundStatement();
+    Stmt *SkipBody();
+    List<Stmt*> *ParseStatementList();
+    Stmt *ParseStatement();
+    Stmt *ParseSingleStatement();
+    Expr *ParseParenthesized();
+    Expr *ParseExpression();
+    Expr *ParseBinary(Expr *left, int minPrecedence);
+    Expr *ParseUnary();
+    Expr *ParsePostfix();
+    Expr *ParsePrimary(yyltype *span);
+    Expr *ParseCall(Atom name, yyltype nameLoc);
+
+  public:
+        // With build false, the parser only recognizes the input: it
+        // reports the same syntax errors but builds no tree, allocates
+        // nothing, and hands the session no program. Function bodies
+        // are left for later if the session says so.
+    RDParser(ParserSession *session, bool build = true);
+
+        // Parses the whole input, as yyparse() would, and hands the
+        // program to the session (which checks it). Returns false after
+        // a syntax error, which has been reported.
+    bool Parse();
+
+        // Parses a function body, braces and all, from tokens (and not
+        // from a session, which may be NULL). Returns the StmtBlock, or
+        // NULL after a syntax error, which has been reported.
+    Stmt *ParseBody(const std::vector<Preprocessor::PPToken> &tokens);
+};
+
+#endif
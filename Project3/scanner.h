@@ -9,15 +9,114 @@
 #define _H_scanner
 
 #include <stdio.h>
+#include <string>
+#include <vector>
+#include "location.h"
+#include "source.h"
 
 #define MaxIdentLen 31    // Maximum length for identifiers
+#define TAB_SIZE 8        // Tab stops, for column numbers
 
-extern char *yytext;      // Text of lexeme just scanned
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;   // Opaque handle to one reentrant scanner
+#endif
+
+/* Struct: ScannerState
+ * --------------------
+ * Bookkeeping the scanner keeps between calls to yylex. One instance
+ * is owned by each scanner (flex's yyextra) so that separate
+ * compilations never share it. Rather than a copy of every line, it
+ * keeps the offset of the start of each line in the source being
+ * scanned (lineStarts[n-1] for line n).
+ *
+ * The Skip methods step over whitespace and comments, which produce no
+ * tokens, a vector at a time (see charscan.h) while keeping the line
+ * counter and the line index up to date. Both the flex
+ * scanner and FastLexer use them. Each takes the position to start at
+ * and returns the position just past what it skipped.
+ */
+struct ScannerState {
+    int curLineNum;
+    const char *base;                    // the source being scanned
+    size_t length;
+    std::vector<unsigned int> lineStarts;
+    std::string lineText;                // last line built for an error
+    std::string directiveText;           // last directive skipped
+
+    ScannerState() : curLineNum(1), base(NULL), length(0),
+                     lineStarts(1, 0) {}
+
+        // Bookkeeping for a newline (next is the start of the new line)
+    void NewLine(const char *next);
+
+        // Spaces, tabs and newlines
+    const char *SkipWhitespace(const char *p);
+        // The rest of a // comment, up to the newline
+    const char *SkipLineComment(const char *p);
+        // The rest of a /* comment, through the */; NULL if the input
+        // ends first
+    const char *SkipBlockComment(const char *p);
+
+        // Whether only spaces and tabs come before p on its line (so a
+        // '#' at p starts a preprocessor directive)
+    bool AtLineStart(const char *p);
+        // The rest of a directive, from just past its '#' to the newline
+        // that ends it (not skipped). The text goes into directiveText
+        // with any backslash-newline continuations taken out; each one
+        // still counts as a new line.
+    const char *SkipDirective(const char *p);
+
+        // The text of line n, or NULL if it has not been reached; valid
+        // until the next call
+    const char *GetLine(int n);
+
+        // Sets *offset to where line n starts in the source; false if
+        // the line has not been reached
+    bool GetLineStart(int n, unsigned int *offset);
+};
+
+/* Function: ColumnOf
+ * ------------------
+ * The column of the byte n bytes into the text of a line: one column
+ * per byte, with a tab moving on to the next tab stop as the scanner's
+ * single-character rules always counted it.
+ */
+inline int ColumnOf(const char *line, unsigned int n)
+{
+    int column = 1;
+    for (unsigned int i = 0; i < n; i++) {
+        column++;
+        if (line[i] == '\t') column += TAB_SIZE - column%TAB_SIZE + 1;
+    }
+    return column;
+}
+
+/* Functions: ScanInteger, ScanFloat
+ * ---------------------------------
+ * Convert the len characters of a numeric constant at text, which need
+ * not be NUL-terminated, and report a value that does not fit with
+ * ReportError::ConstantOutOfRange at loc. An integer (decimal, or hex
+ * with its 0x prefix) must fit in 32 bits; the result is that bit
+ * pattern, so 0xFFFFFFFF is a valid int constant (-1). A float may end
+ * in f or F and must fit in a (single-precision) float. Out-of-range
+ * constants come back as 0, reported only if loc is not NULL. Defined
+ * in scanstate.cc and used by both lexers.
+ */
+unsigned int ScanInteger(const char *text, size_t len, int base, yyltype *loc);
+double ScanFloat(const char *text, size_t len, yyltype *loc);
+
+union YYSTYPE;
 
+int yylex(YYSTYPE *, yyltype *, yyscan_t); // Defined in the generated lex.yy.c file
 
-int yylex();              // Defined in the generated lex.yy.c file
+yyscan_t InitScanner(SourceBuffer *source); // Defined in scanner.l user subroutines
+void FreeScanner(yyscan_t scanner);         // ditto
+const char *GetLineNumbered(yyscan_t scanner, int n); // ditto
+ScannerState *GetScannerState(yyscan_t scanner);      // ditto
 
-void InitScanner();                 // Defined in scanner.l user subroutines
-const char *GetLineNumbered(int n); // ditto
+const char *GetLineNumbered(int n);         // Defined in parser.y, for the
+yyltype *GetLastLocation();                 // compilation on this thread
+bool GetColumns(const yyltype *loc, int *first, int *last);   // ditto
  
 #endif
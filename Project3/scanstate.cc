@@ -0,0 +1,109 @@
+/* File: scanstate.cc
+ * ------------------
+ * Implementation of the ScannerState methods that skip whitespace and
+ * comments, and of the numeric constant conversions.
+ */
+
+#include <string.h>
+#include <float.h>
+#include <charconv>
+#include "scanner.h"
+#include "errors.h"
+#include "charscan.h"
+
+void ScannerState::NewLine(const char *next) {
+    curLineNum++;
+    lineStarts.push_back(next - base);
+}
+
+const char *ScannerState::SkipWhitespace(const char *p) {
+    const char *end = base + length;
+    while (p < end) {
+        p += Span<CC_Space>(p, end);
+        if (p == end || *p != '\n') break;
+        NewLine(++p);
+    }
+    return p;
+}
+
+const char *ScannerState::SkipLineComment(const char *p) {
+    const char *end = base + length;
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    return nl ? nl : end;
+}
+
+const char *ScannerState::SkipBlockComment(const char *p) {
+    const char *end = base + length;
+    while (true) {
+        p += Span<CC_CommentText>(p, end);
+        if (p == end) return NULL;
+
+        char ch = *p++;
+        if (ch == '\n')
+            NewLine(p);
+        else if (ch == '*' && p < end && *p == '/')
+            return p + 1;
+    }
+}
+
+bool ScannerState::AtLineStart(const char *p) {
+    for (const char *q = base + lineStarts.back(); q < p; q++)
+        if (*q != ' ' && *q != '\t') return false;
+    return true;
+}
+
+const char *ScannerState::SkipDirective(const char *p) {
+    const char *end = base + length;
+    directiveText.clear();
+    while (p < end && *p != '\n') {
+        if (*p == '\\' && p + 1 < end && p[1] == '\n') {
+            p += 2;
+            NewLine(p);
+            continue;
+        }
+        directiveText += *p++;
+    }
+    return p;
+}
+
+const char *ScannerState::GetLine(int num) {
+    if (num <= 0 || num > lineStarts.size()) return NULL;
+    const char *start = base + lineStarts[num-1];
+    const char *nl = (const char *)memchr(start, '\n', base + length - start);
+    lineText.assign(start, nl ? nl : base + length);
+    return lineText.c_str();
+}
+
+bool ScannerState::GetLineStart(int num, unsigned int *offset) {
+    if (num <= 0 || num > lineStarts.size()) return false;
+    *offset = lineStarts[num-1];
+    return true;
+}
+
+/* std::from_chars works on the lexeme in place, ignores the locale and
+ * says when a value does not fit, none of which strtol/atof on yytext
+ * did.
+ */
+unsigned int ScanInteger(const char *text, size_t len, int base, yyltype *loc) {
+    const char *digits = (base == 16) ? text + 2 : text;   // skip the 0x
+    unsigned int value;
+    std::from_chars_result r = std::from_chars(digits, text + len, value, base);
+    if (r.ec != std::errc() || r.ptr != text + len) {
+        if (loc) ReportError::ConstantOutOfRange(loc, std::string(text, len).c_str());
+        return 0;
+    }
+    return value;
+}
+
+double ScanFloat(const char *text, size_t len, yyltype *loc) {
+    const char *stop = text + len;
+    if (stop[-1] == 'f' || stop[-1] == 'F') stop--;
+    double value;
+    std::from_chars_result r = std::from_chars(text, stop, value,
+                                               std::chars_format::fixed);
+    if (r.ec != std::errc() || r.ptr != stop || value > FLT_MAX) {
+        if (loc) ReportError::ConstantOutOfRange(loc, std::string(text, len).c_str());
+        return 0;
+    }
+    return value;
+}
@@ -0,0 +1,111 @@
+/* File: source.cc
+ * ---------------
+ * Implementation of SourceBuffer.
+ */
+
+#include "source.h"
+#include "utility.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SourceBuffer::SourceBuffer() {
+    base = NULL;
+    length = 0;
+    reserved = 0;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (base && reserved) munmap(base, reserved);
+    else free(base);
+}
+
+/* The file is mapped over the front of a larger anonymous reservation.
+ * The kernel zero-fills the tail of the last file page and the
+ * anonymous pages behind it, so the sentinel bytes are already NUL
+ * without touching (or copying) any of the file's pages. MAP_PRIVATE
+ * keeps flex's temporary NUL-terminations out of the file itself.
+ */
+bool SourceBuffer::MapFile(const char *path) {
+    Assert(base == NULL);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = info.st_size;
+    size_t total = (size + SourcePadding + pageSize - 1) / pageSize * pageSize;
+
+    void *region = mmap(NULL, total, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (size > 0 &&
+        mmap(region, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(region, total);
+        close(fd);
+        return false;
+    }
+    close(fd);
+    madvise(region, total, MADV_SEQUENTIAL);
+
+    base = (char *)region;
+    length = size;
+    reserved = total;
+    return true;
+}
+
+void SourceBuffer::CopyText(const char *text, size_t len) {
+    Assert(base == NULL);
+    char *buffer = (char *)malloc(len + SourcePadding);
+    if (!buffer) Failure("Out of memory copying input");
+    memcpy(buffer, text, len);
+    memset(buffer + len, 0, SourcePadding);
+
+    base = buffer;
+    length = len;
+    reserved = 0;
+}
+
+bool SourceBuffer::ReadStream(FILE *in) {
+    Assert(base == NULL);
+    size_t capacity = 64*1024, size = 0;
+    char *buffer = (char *)malloc(capacity);
+    if (!buffer) Failure("Out of memory reading input");
+
+    size_t n;
+    while ((n = fread(buffer + size, 1, capacity - size - SourcePadding, in)) > 0) {
+        size += n;
+        if (capacity - size <= SourcePadding) {
+            capacity *= 2;
+            buffer = (char *)realloc(buffer, capacity);
+            if (!buffer) Failure("Out of memory reading input");
+        }
+    }
+    if (ferror(in)) {
+        free(buffer);
+        return false;
+    }
+    memset(buffer + size, 0, SourcePadding);
+
+    base = buffer;
+    length = size;
+    reserved = 0;
+    return true;
+}
+
+uint64_t HashText(const char *text, size_t len, uint64_t h) {
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)text[i]) * 1099511628211ull;
+    return h;
+}
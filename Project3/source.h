@@ -0,0 +1,59 @@
+/* File: source.h
+ * --------------
+ * A SourceBuffer holds the complete text of one shader in memory so
+ * that the scanner can lex it in place (flex's yy_scan_buffer) instead
+ * of copying it through its own buffered reader. Lexemes then point
+ * straight into the source bytes, and the text stays around for error
+ * messages to quote.
+ *
+ * flex requires the buffer to end with two NUL sentinel bytes and to be
+ * writable (it temporarily NUL-terminates each lexeme), so the buffer is
+ * always followed by that padding, and files are mapped copy-on-write.
+ */
+
+#ifndef _H_source
+#define _H_source
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SourcePadding 2   // NUL sentinels flex needs after the text
+
+class SourceBuffer
+{
+  protected:
+    char *base;
+    size_t length;    // bytes of source text, not counting the padding
+    size_t reserved;  // bytes of address space mapped at base, 0 if malloc'ed
+
+  public:
+    SourceBuffer();
+    ~SourceBuffer();
+
+          // Maps the named file into memory followed by the sentinel
+          // padding. Returns false if the file cannot be opened or mapped.
+    bool MapFile(const char *path);
+
+          // Reads the rest of the stream (such as stdin, which cannot be
+          // mapped) into a heap buffer followed by the sentinel padding.
+    bool ReadStream(FILE *in);
+
+          // Copies text already in memory (an editor's buffer, say) into
+          // a heap buffer followed by the sentinel padding.
+    void CopyText(const char *text, size_t len);
+
+    char *GetBase() const     { return base; }
+    size_t GetLength() const  { return length; }
+};
+
+/* Function: HashText
+ * ------------------
+ * A 64-bit FNV-1a hash of len bytes of text, for telling whether a
+ * source is the same bytes as one seen before. Passing the hash of some
+ * earlier bytes as h continues it, hashing the two runs as one.
+ */
+#define HashStart 14695981039346656037ull
+uint64_t HashText(const char *text, size_t len, uint64_t h = HashStart);
+
+#endif
@@ -0,0 +1,129 @@
+/* File: streamlex.cc
+ * ------------------
+ * Implementation of StreamLexer.
+ */
+
+#include <string.h>
+#include "streamlex.h"
+#include "utility.h"
+
+StreamLexer::StreamLexer(FILE *in)
+{
+    PrintDebug("lex", "Initializing stream lexer, %d byte chunks", StreamChunkSize);
+    this->in = in;
+    buffer.resize(StreamChunkSize + SourcePadding);
+    chunkFirstLine = 1;
+    chunkOffset = 0;
+    numChunks = 0;
+    recentFirstLine = 1;
+    moreInput = true;
+}
+
+/* Copies the last StreamKeepLines complete lines of the chunk being
+ * dropped into the ring. Every line but the last of the line index
+ * ends with a newline inside the chunk; the last starts at its end.
+ */
+void StreamLexer::KeepRecentLines()
+{
+    int complete = scan.lineStarts.size() - 1;
+    int first = complete > StreamKeepLines ? complete - StreamKeepLines : 0;
+    for (int i = first; i < complete; i++) {
+        recent.push_back(std::string(scan.base + scan.lineStarts[i],
+                                     scan.base + scan.lineStarts[i+1] - 1));
+        recentStarts.push_back(offsetBase + scan.lineStarts[i]);
+    }
+    while (recent.size() > StreamKeepLines) {
+        recent.pop_front();
+        recentStarts.pop_front();
+    }
+    recentFirstLine = chunkFirstLine + complete - recent.size();
+}
+
+/* Reads the next chunk: the carried-over partial line, then as much
+ * input as fits, cut after the last newline. If there is no newline in
+ * a full buffer, the buffer doubles until the line fits.
+ */
+void StreamLexer::Refill()
+{
+    KeepRecentLines();
+    chunkOffset += scan.length;
+    chunkFirstLine = scan.curLineNum;
+
+    size_t size = pending.size();
+    if (size + SourcePadding > buffer.size()) buffer.resize(size + SourcePadding);
+    memcpy(buffer.data(), pending.data(), size);
+
+    size_t cut;
+    bool atEnd = false;
+    while (true) {
+        size_t room = buffer.size() - SourcePadding - size;
+        size_t n = fread(buffer.data() + size, 1, room, in);
+        size += n;
+        if (n < room) {                 // end of input (or an error)
+            atEnd = true;
+            cut = size;
+            break;
+        }
+        // The last newline that ends a line (one after a backslash only
+        // continues a directive)
+        const char *nl = (const char *)memrchr(buffer.data(), '\n', size);
+        while (nl && nl > buffer.data() && nl[-1] == '\\')
+            nl = (const char *)memrchr(buffer.data(), '\n', nl - buffer.data());
+        if (nl) {
+            cut = nl + 1 - buffer.data();
+            break;
+        }
+        buffer.resize(2*buffer.size());
+    }
+    if (ferror(in)) Failure("Error reading input");
+
+    pending.assign(buffer.data() + cut, size - cut);
+    memset(buffer.data() + cut, 0, SourcePadding);
+    scan.base = cur = buffer.data();
+    offsetBase = (unsigned int)chunkOffset;
+    scan.length = cut;
+    scan.lineStarts.assign(1, 0);
+    end = cur + cut;
+    moreInput = !atEnd;
+    numChunks++;
+}
+
+int StreamLexer::NextToken(YYSTYPE *lval, yyltype *loc)
+{
+    while (true) {
+        int token = FastLexer::NextToken(lval, loc);
+        if (token != 0) return token;
+        if (!moreInput) break;
+        Refill();
+    }
+    PrintDebug("stream", "%llu bytes in %d chunks, buffer %lu bytes, %lu lines kept",
+               chunkOffset + scan.length, numChunks,
+               (unsigned long)buffer.size(), (unsigned long)recent.size());
+    return 0;
+}
+
+const char *StreamLexer::GetLineNumbered(int n)
+{
+    int i = n - chunkFirstLine;
+    if (i >= 0 && i < scan.lineStarts.size()) {
+        const char *start = scan.base + scan.lineStarts[i];
+        const char *nl = (const char *)memchr(start, '\n', end - start);
+        scan.lineText.assign(start, nl ? nl : end);
+        return scan.lineText.c_str();
+    }
+    i = n - recentFirstLine;
+    if (i >= 0 && i < recent.size()) return recent[i].c_str();
+    return NULL;
+}
+
+bool StreamLexer::GetLineStart(int n, unsigned int *offset)
+{
+    if (scan.GetLineStart(n - chunkFirstLine + 1, offset)) {
+        *offset += offsetBase;
+        return true;
+    }
+    int i = n - recentFirstLine;
+    if (i < 0 || i >= recentStarts.size()) return false;
+    *offset = recentStarts[i];
+    return true;
+}
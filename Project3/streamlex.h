@@ -0,0 +1,67 @@
+/* File: streamlex.h
+ * -----------------
+ * A lexer for input too big to hold in memory (the -lexer=stream
+ * option), such as the shader bundles an offline bake concatenates.
+ * Instead of one SourceBuffer for the whole input, StreamLexer reads
+ * it StreamChunkSize bytes at a time and runs FastLexer over each
+ * chunk. A chunk always ends just after a newline that ends a line
+ * (not one continuing a directive; the partial line after it is
+ * carried over to the next chunk), and no token spans lines but a
+ * directive, so the only thing that can cross from one chunk to
+ * the next is a block comment, which FastLexer waits out in its
+ * Comment state.
+ *
+ * The line index covers only the current chunk. For error messages
+ * about earlier lines, the last StreamKeepLines lines of each chunk
+ * are kept in a ring as the chunk is dropped; lines older than that
+ * are not quoted. Memory for the scan is then the chunk buffer (more
+ * only for a single line longer than a chunk) plus that ring, however
+ * long the input is. The parser and the AST it builds still grow with
+ * the program.
+ */
+
+#ifndef _H_streamlex
+#define _H_streamlex
+
+#include <stdio.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "fastlex.h"
+
+#define StreamChunkSize (1 << 20)   // bytes read at a time
+#define StreamKeepLines 64          // earlier lines kept for error messages
+
+class StreamLexer : public FastLexer
+{
+  protected:
+    FILE *in;
+    std::vector<char> buffer;           // the chunk, then the NUL padding
+    std::string pending;                // the partial line after the chunk
+    int chunkFirstLine;                 // the number of the chunk's first line
+    unsigned long long chunkOffset;     // where the chunk starts in the input
+    int numChunks;
+    std::deque<std::string> recent;     // the lines kept from earlier chunks
+    std::deque<unsigned int> recentStarts;  // and where each starts
+    int recentFirstLine;                // the number of recent.front()
+
+    void KeepRecentLines();
+    void Refill();
+
+  public:
+    StreamLexer(FILE *in);              // in must stay open while scanning
+
+        // As FastLexer::NextToken, reading more input as it is needed
+    int NextToken(YYSTYPE *lval, yyltype *loc);
+
+        // The text of line n if it is in the current chunk or the ring,
+        // else NULL
+    const char *GetLineNumbered(int n);
+
+        // Sets *offset to where line n starts if it is in the current
+        // chunk or the ring, else returns false. Offsets are 32 bits,
+        // as in yyltype, so they wrap every 4 GiB of input.
+    bool GetLineStart(int n, unsigned int *offset);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# File: streamtest.py
+#
+# Checks that -lexer=stream keeps its memory bounded however long the
+# input is: generates a program of several GB (the same block of
+# functions and comments over and over, with block comments that cross
+# the lexer's chunk boundaries) and pipes it into
+#     ./glc -lexer=stream -syntax-only
+# which builds no tree, so nothing should grow with the input. Fails if
+# glc exits non-zero or its peak RSS goes over the limit. Nothing is
+# written to disk.
+#
+# Usage: streamtest.py [-size=<GB>] [-max-rss=<MB>]
+
+# Standard library imports:
+import os
+import resource
+import subprocess
+import sys
+import time
+
+
+# Constants:
+DEFAULT_GB = 4
+DEFAULT_MAX_RSS_MB = 64
+GLC_CMD = ["./glc", "-lexer=stream", "-syntax-only"]
+WRITE_SIZE = 1 << 20
+
+BLOCK = """\
+// a line comment before each function
+float scale(float x, float y) {
+    float z;
+    /* a block comment
+       over a few lines */
+    z = x * y + 1.0;
+    if (z > 2.0) { z = z - 1.0; } else { z = z + 1.0; }
+    return z;
+}
+vec4 shade(vec4 color, int n) {
+    int i;
+    for (i = 0; i < n; i++) { color.xy = color.yx * 0.5; }
+    while (n > 0) { n = n - 1; }
+    return color;
+}
+"""
+
+
+def get_option(name, default):
+    """Returns the value of -name=<value> on the command line, or default."""
+    for arg in sys.argv[1:]:
+        if arg.startswith("-" + name + "="):
+            return float(arg.split("=", 1)[1])
+    return default
+
+
+def make_chunk():
+    """
+    Returns about WRITE_SIZE bytes of whole blocks, with a long block
+    comment at the end, so that wherever the lexer's chunks end, some
+    comment is open across the boundary.
+    """
+    comment = "/*" + ("x" * 70 + "\n") * 100 + "*/\n"
+    text = BLOCK * (WRITE_SIZE // len(BLOCK))
+    return (text + comment).encode()
+
+
+def main():
+    size = int(get_option("size", DEFAULT_GB) * (1 << 30))
+    max_rss = get_option("max-rss", DEFAULT_MAX_RSS_MB)
+    if not os.access("glc", os.X_OK):
+        print("Error: glc not executable")
+        return 1
+
+    chunk = make_chunk()
+    glc = subprocess.Popen(GLC_CMD, stdin=subprocess.PIPE)
+    start = time.time()
+    written = 0
+    try:
+        while written < size:
+            glc.stdin.write(chunk)
+            written += len(chunk)
+        glc.stdin.close()
+    except BrokenPipeError:
+        print("glc stopped reading after %d bytes" % written)
+    status = glc.wait()
+    seconds = time.time() - start
+
+    # ru_maxrss is in KB on Linux; glc is the only child
+    rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss / 1024.0
+    print("%.2f GB in %.1f s, exit status %d, peak RSS %.1f MB"
+          % (written / float(1 << 30), seconds, status, rss))
+    if status != 0:
+        print("failed: glc exited with status %d" % status)
+        return 1
+    if rss > max_rss:
+        print("failed: peak RSS is over %d MB" % max_rss)
+        return 1
+    print("passed")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -13,16 +13,17 @@ ScopedTable::~ScopedTable() {
 }
 
 void ScopedTable::insert(Symbol &sym) {
-	symbols.insert(std::pair<const char *, Symbol>(sym.name, sym));
+	symbols.insert(std::pair<Atom, Symbol>(sym.name, sym));
 }
 
 void ScopedTable::remove(Symbol &sym) {
 	symbols.erase(sym.name);
 }
 
-Symbol *ScopedTable::find(const char *name) {
-    if (symbols.find(name) != symbols.end())
-	   return &(symbols.find(name)->second);
+Symbol *ScopedTable::find(Atom name) {
+    SymbolIterator it = symbols.find(name);
+    if (it != symbols.end())
+	   return &(it->second);
     else
         return NULL;
 }
@@ -34,7 +35,13 @@ SymbolTable::SymbolTable() {
 	push();
 }
 
+SymbolTable::SymbolTable(const ScopedTable &globals) {
+	tables.push_back(new ScopedTable(globals));
+}
+
 SymbolTable::~SymbolTable() {
+	for (size_t i = 0; i < tables.size(); i++)
+		delete tables[i];
 }
 
 void SymbolTable::push() {
@@ -42,9 +49,16 @@ void SymbolTable::push() {
 }
 
 void SymbolTable::pop() {
+	delete tables.back();
 	tables.pop_back();
 }
 
+ScopedTable *SymbolTable::takeGlobals() {
+	ScopedTable *globals = tables.front();
+	tables.erase(tables.begin());
+	return globals;
+}
+
 void SymbolTable::insert(Symbol &sym) {
 	tables.back()->insert(sym);
 }
@@ -53,7 +67,7 @@ void SymbolTable::remove(Symbol &sym) {
 	tables.back()->remove(sym);
 }
 
-Symbol *SymbolTable::find(const char *name, bool *currentScope) {
+Symbol *SymbolTable::find(Atom name, bool *currentScope) {
 	if (*currentScope) {
 		return tables.back()->find(name);
 	} else {
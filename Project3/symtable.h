@@ -4,7 +4,8 @@
  *  This file defines a class for symbol table and scoped table table.
  *
  *  Scoped table is to hold all declarations in a nested scope. It simply
- *  uses the standard C++ map.
+ *  uses the standard C++ map, keyed by the identifier's Atom, so a lookup
+ *  compares pointers rather than strings (see atom.h).
  *
  *  Symbol table is implemented as a vector, where each vector entry holds
  *  a pointer to the scoped table.
@@ -18,6 +19,7 @@
 #include <iostream>
 #include <string.h>
 #include "errors.h"
+#include "atom.h"
 
 using namespace std;
 
@@ -30,28 +32,23 @@ enum EntryKind {
 };
 
 struct Symbol {
-  char *name;
+  Atom name;
   Decl *decl;
   EntryKind kind;
   int someInfo;
 
   Symbol() : name(NULL), decl(NULL), kind(E_VarDecl), someInfo(0) {}
-  Symbol(char *n, Decl *d, EntryKind k, int info = 0) :
+  Symbol(Atom n, Decl *d, EntryKind k, int info = 0) :
         name(n),
         decl(d),
         kind(k),
         someInfo(info) {}
 };
 
-struct lessStr {
-  bool operator()(const char* s1, const char* s2) const
-  { return strcmp(s1, s2) < 0; }
-};
- 
-typedef map<const char *, Symbol, lessStr>::iterator SymbolIterator;
+typedef map<Atom, Symbol>::iterator SymbolIterator;
 
 class ScopedTable {
-  map<const char *, Symbol, lessStr> symbols;
+  map<Atom, Symbol> symbols;
 
   public:
     ScopedTable();
@@ -59,7 +56,7 @@ class ScopedTable {
 
     void insert(Symbol &sym); 
     void remove(Symbol &sym);
-    Symbol *find(const char *name);
+    Symbol *find(Atom name);
 };
    
 class SymbolTable {
@@ -67,6 +64,7 @@ class SymbolTable {
  
   public:
     SymbolTable();
+    SymbolTable(const ScopedTable &globals); // starts with a copy of globals
     ~SymbolTable();
 
     void push();
@@ -74,7 +72,9 @@ class SymbolTable {
 
     void insert(Symbol &sym);
     void remove(Symbol &sym);
-    Symbol *find(const char *name, bool *currentScope);
+    Symbol *find(Atom name, bool *currentScope);
+    ScopedTable *globals() { return tables.front(); }
+    ScopedTable *takeGlobals(); // the caller frees it; the table is then empty
 
 };    
 
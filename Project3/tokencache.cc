@@ -0,0 +1,209 @@
+/* File: tokencache.cc
+ * -------------------
+ * Implementation of the token cache. A cache file is the header below
+ * followed by the TokenBuffer arrays in order (kinds, offsets, lengths,
+ * lines, values, valueTable, line starts) and then the atom
+ * spellings, NUL-terminated one after the other. An atom value is
+ * stored as the offset of its spelling in that last block and interned
+ * again on load. Numbers are in the byte order of the machine; a cache
+ * is not meant to be shared between architectures.
+ */
+
+#include "tokencache.h"
+#include "parser.h"     // for token codes
+#include "utility.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <map>
+#include <string>
+using std::string;
+using std::vector;
+
+#ifndef SCANNER_VERSION
+#define SCANNER_VERSION 0     // the Makefile passes a checksum of the scanner
+#endif
+
+static const char CacheMagic[4] = {'G', 'L', 'C', 'T'};
+static const uint32_t CacheFormat = 2;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t format, scanner;
+    uint32_t numTokens, numValues, numLines, atomBytes;
+    uint64_t sourceHash, sourceLength;
+};
+
+static std::atomic<unsigned long> numHits(0), numMisses(0), numStores(0);
+
+static string CachePath(const char *dir, uint64_t hash) {
+    char name[32];
+    sprintf(name, "/%016llx.tok", (unsigned long long)hash);
+    return string(dir) + name;
+}
+
+template<class T> static bool ReadArray(FILE *f, vector<T> &v, size_t n) {
+    v.resize(n);
+    return n == 0 || fread(v.data(), sizeof(T), n, f) == n;
+}
+
+template<class T> static bool WriteArray(FILE *f, const vector<T> &v) {
+    return v.empty() || fwrite(v.data(), sizeof(T), v.size(), f) == v.size();
+}
+
+/* Whether kind is one of the parser's token codes: those of the %token
+ * lines in parser.y run from T_Void to T_Directive.
+ */
+static bool IsTokenKind(unsigned short kind) {
+    return kind >= T_Void && kind <= T_Directive;
+}
+
+/* Reads everything after the header, checking that every index stays
+ * in bounds so a damaged file is a miss rather than a crash: each token
+ * one the parser knows (but the last, the end of input), within the
+ * source and on one of its lines (or line 0, as the end of input can
+ * be), the line starts in order from 0 and within the source, and each
+ * value in the table.
+ */
+static TokenBuffer *ReadTokens(FILE *f, const CacheHeader &h,
+                               const char *base, size_t length) {
+    if (h.numTokens == 0 || h.numTokens > length + 1 ||
+        h.numValues > h.numTokens || h.numLines == 0 || h.numLines > length + 1)
+        return NULL;
+
+    TokenBuffer *tokens = new TokenBuffer(base, length);
+    vector<char> atoms;
+    bool ok = ReadArray(f, tokens->kinds, h.numTokens) &&
+              ReadArray(f, tokens->offsets, h.numTokens) &&
+              ReadArray(f, tokens->lengths, h.numTokens) &&
+              ReadArray(f, tokens->lines, h.numTokens) &&
+              ReadArray(f, tokens->values, h.numTokens) &&
+              ReadArray(f, tokens->valueTable, h.numValues) &&
+              ReadArray(f, tokens->source.lineStarts, h.numLines) &&
+              ReadArray(f, atoms, h.atomBytes) &&
+              (atoms.empty() || atoms.back() == '\0') &&
+              tokens->kinds.back() == 0;
+
+    const vector<unsigned int> &starts = tokens->source.lineStarts;
+    for (size_t n = 0; ok && n < starts.size(); n++)
+        ok = (n == 0 ? starts[n] == 0 : starts[n] > starts[n-1]) && starts[n] <= length;
+    for (int i = 0; ok && i < tokens->NumTokens(); i++) {
+        ok = (i == tokens->NumTokens() - 1 || IsTokenKind(tokens->kinds[i])) &&
+             (uint64_t)tokens->offsets[i] + tokens->lengths[i] <= length &&
+             tokens->lines[i] >= 0 && tokens->lines[i] <= (int)h.numLines;
+        if (!ok) break;
+        unsigned int v = tokens->values[i];
+        if (v == TokenBuffer::NoValue) continue;
+        ok = v < h.numValues;
+        if (ok && ValueKindOf(tokens->kinds[i]) == V_Atom) {
+            TokenValue &value = tokens->valueTable[v];
+            ok = value.uintConstant < h.atomBytes;
+            if (ok) value.identifier = AtomTable::Intern(&atoms[value.uintConstant]);
+        }
+    }
+    if (!ok) {
+        delete tokens;
+        return NULL;
+    }
+    return tokens;
+}
+
+TokenBuffer *TokenCache::Load(const char *dir, const char *base, size_t length) {
+    uint64_t hash = HashText(base, length);
+    FILE *f = fopen(CachePath(dir, hash).c_str(), "rb");
+    TokenBuffer *tokens = NULL;
+    if (f) {
+        CacheHeader h;
+        if (fread(&h, sizeof(h), 1, f) == 1 &&
+            memcmp(h.magic, CacheMagic, sizeof(CacheMagic)) == 0 &&
+            h.format == CacheFormat && h.scanner == SCANNER_VERSION &&
+            h.sourceHash == hash && h.sourceLength == length)
+            tokens = ReadTokens(f, h, base, length);
+        fclose(f);
+    }
+    if (tokens) numHits++;
+    else numMisses++;
+    return tokens;
+}
+
+void TokenCache::Store(const char *dir, const TokenBuffer *tokens) {
+    const ScannerState &source = tokens->source;
+
+    // Copy each value's own member into zeroed bytes, so the same tokens
+    // always make the same file, and swap each atom for the offset of
+    // its spelling in the atom block
+    vector<TokenValue> values(tokens->valueTable.size());
+    memset(values.data(), 0, values.size() * sizeof(TokenValue));
+    string atoms;
+    std::map<Atom, unsigned int> atomOffsets;
+    for (int i = 0; i < tokens->NumTokens(); i++) {
+        unsigned int v = tokens->values[i];
+        if (v == TokenBuffer::NoValue) continue;
+        const TokenValue &value = tokens->valueTable[v];
+        switch (ValueKindOf(tokens->kinds[i])) {
+          case V_None:    break;
+          case V_Integer: values[v].integerConstant = value.integerConstant; break;
+          case V_Uint:    values[v].uintConstant = value.uintConstant; break;
+          case V_Float:   values[v].floatConstant = value.floatConstant; break;
+          case V_Bool:    values[v].boolConstant = value.boolConstant; break;
+          case V_Atom: {
+            Atom atom = value.identifier;
+            std::map<Atom, unsigned int>::iterator it = atomOffsets.find(atom);
+            if (it == atomOffsets.end()) {
+                it = atomOffsets.insert(std::make_pair(atom, (unsigned int)atoms.size())).first;
+                atoms.append(atom, strlen(atom) + 1);
+            }
+            values[v].uintConstant = it->second;
+            break;
+          }
+        }
+    }
+
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CacheMagic, sizeof(CacheMagic));
+    h.format = CacheFormat;
+    h.scanner = SCANNER_VERSION;
+    h.numTokens = tokens->NumTokens();
+    h.numValues = values.size();
+    h.numLines = source.lineStarts.size();
+    h.atomBytes = atoms.size();
+    h.sourceHash = HashText(source.base, source.length);
+    h.sourceLength = source.length;
+
+    mkdir(dir, 0777);                   // fine if it is already there
+    string path = CachePath(dir, h.sourceHash);
+    string temp = path + ".XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0) return;
+    FILE *f = fdopen(fd, "wb");
+    if (!f) {
+        close(fd);
+        unlink(temp.c_str());
+        return;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              WriteArray(f, tokens->kinds) &&
+              WriteArray(f, tokens->offsets) &&
+              WriteArray(f, tokens->lengths) &&
+              WriteArray(f, tokens->lines) &&
+              WriteArray(f, tokens->values) &&
+              WriteArray(f, values) &&
+              WriteArray(f, source.lineStarts) &&
+              (atoms.empty() ||
+               fwrite(atoms.data(), 1, atoms.size(), f) == atoms.size());
+    ok = (fclose(f) == 0) && ok;
+    if (ok) chmod(temp.c_str(), 0644);
+    if (ok && rename(temp.c_str(), path.c_str()) == 0)
+        numStores++;
+    else
+        unlink(temp.c_str());
+}
+
+void TokenCache::PrintStats() {
+    PrintDebug("tokencache", "%lu hits, %lu misses, %lu stores",
+               numHits.load(), numMisses.load(), numStores.load());
+}
@@ -0,0 +1,40 @@
+/* File: tokencache.h
+ * ------------------
+ * An on-disk cache of token streams (the -token-cache=<dir> option).
+ * A source that scanned without errors has its TokenBuffer written to
+ * <dir>/<hash>.tok, where <hash> is a hash of the source bytes. The
+ * next compilation of the same bytes loads that file instead of
+ * scanning at all.
+ *
+ * Each file starts with a header giving the file format version, the
+ * scanner version (a checksum of the scanner sources and parser.y, whose
+ * token codes the kinds are, that the Makefile passes in as
+ * SCANNER_VERSION), and the length and hash of the source. A file whose
+ * header does not match exactly is a miss, so rebuilding glc after a
+ * scanner or token change retires all old entries. Files are written
+ * under a temporary name and renamed into place, so compilations
+ * sharing a cache never see a partial file.
+ */
+
+#ifndef _H_tokencache
+#define _H_tokencache
+
+#include <stddef.h>
+#include "tokens.h"
+
+class TokenCache
+{
+  public:
+        // Returns the cached tokens for the given source, or NULL on a
+        // miss. The caller owns the buffer.
+    static TokenBuffer *Load(const char *dir, const char *base, size_t length);
+
+        // Writes tokens (scanned from the source they describe) to the
+        // cache. Failure to write is not an error; the entry is skipped.
+    static void Store(const char *dir, const TokenBuffer *tokens);
+
+        // Prints hits, misses and stores (debug key "tokencache")
+    static void PrintStats();
+};
+
+#endif
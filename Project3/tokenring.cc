@@ -0,0 +1,55 @@
+/* File: tokenring.cc
+ * ------------------
+ * Implementation of the scanner-to-parser token ring. Head and tail
+ * count entries forever (wrapping at 2^32) and are reduced modulo Size
+ * only to index, so the ring is full when they are Size apart and empty
+ * when they are equal.
+ */
+
+#include <thread>
+#include "tokenring.h"
+
+#define SpinsBeforeYield 64
+
+static inline void Pause(int *spins) {
+    if (++*spins < SpinsBeforeYield) return;
+    std::this_thread::yield();
+    *spins = 0;
+}
+
+TokenRing::TokenRing() : head(0), knownTail(0), ended(false),
+                         tail(0), knownHead(0), stopped(false) {
+}
+
+bool TokenRing::Put(int kind, const YYSTYPE *lval, const yyltype *loc) {
+    unsigned int t = tail.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (t - knownHead == Size) {
+        if (stopped.load(std::memory_order_acquire)) return false;
+        knownHead = head.load(std::memory_order_acquire);
+        if (t - knownHead == Size) Pause(&spins);
+    }
+    Entry &e = entries[t & (Size - 1)];
+    e.kind = kind;
+    e.value = *lval;
+    e.loc = *loc;
+    tail.store(t + 1, std::memory_order_release);
+    return !stopped.load(std::memory_order_relaxed);
+}
+
+int TokenRing::Get(YYSTYPE *lval, yyltype *loc) {
+    if (ended) return 0;
+    unsigned int h = head.load(std::memory_order_relaxed);
+    int spins = 0;
+    while (h == knownTail) {
+        knownTail = tail.load(std::memory_order_acquire);
+        if (h == knownTail) Pause(&spins);
+    }
+    const Entry &e = entries[h & (Size - 1)];
+    *lval = e.value;
+    *loc = e.loc;
+    int kind = e.kind;
+    head.store(h + 1, std::memory_order_release);
+    if (kind == 0) ended = true;
+    return kind;
+}
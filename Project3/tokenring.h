@@ -0,0 +1,59 @@
+/* File: tokenring.h
+ * -----------------
+ * A TokenRing carries tokens from a scanner running on a thread of its
+ * own to the parser on another (the -tokens=thread option). It is a
+ * fixed-size single-producer, single-consumer ring: only the scanning
+ * thread writes entries and moves the tail, only the parsing thread
+ * reads them and moves the head, so neither needs a lock, only an
+ * acquire/release pair on each index. The two indices sit on cache
+ * lines of their own, and each side works from a private copy of the
+ * other's index, loading the shared one again only when the ring looks
+ * full (or empty), so the two cores seldom pass a line back and forth.
+ * A side that has to wait spins a little and then yields.
+ *
+ * The scanner always ends with token 0. If the parser stops early (a
+ * syntax error it cannot recover from), Stop() tells the scanner, whose
+ * next Put() then fails.
+ */
+
+#ifndef _H_tokenring
+#define _H_tokenring
+
+#include <atomic>
+#include "parser.h"
+
+class TokenRing
+{
+  public:
+    static constexpr unsigned int Size = 1024;     // entries, a power of 2
+
+    TokenRing();
+
+        // Scanning thread: adds a token, waiting while the ring is full.
+        // Returns false, dropping the token, once the parser has stopped.
+    bool Put(int kind, const YYSTYPE *lval, const yyltype *loc);
+
+        // Parsing thread: takes the next token, waiting while the ring
+        // is empty. After token 0 it returns 0 without waiting.
+    int Get(YYSTYPE *lval, yyltype *loc);
+
+        // Parsing thread: wants no more tokens
+    void Stop()     { stopped.store(true, std::memory_order_release); }
+
+  protected:
+    struct Entry {
+        int kind;
+        YYSTYPE value;
+        yyltype loc;
+    };
+
+    Entry entries[Size];
+    alignas(64) std::atomic<unsigned int> head;  // next entry to read
+    unsigned int knownTail;                      // parser's copy of tail
+    bool ended;                                  // parser has had token 0
+    alignas(64) std::atomic<unsigned int> tail;  // next entry to write
+    unsigned int knownHead;                      // scanner's copy of head
+    alignas(64) std::atomic<bool> stopped;
+};
+
+#endif
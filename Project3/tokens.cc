@@ -0,0 +1,201 @@
+/* File: tokens.cc
+ * ---------------
+ * Implementation of TokenBuffer.
+ */
+
+#include "tokens.h"
+#include "parser.h"     // for token codes, YYSTYPE
+#include "fastlex.h"
+#include "utility.h"
+
+ValueKind ValueKindOf(int token) {
+    switch (token) {
+      case T_IntConstant:   return V_Integer;
+      case T_UintConstant:  return V_Uint;
+      case T_FloatConstant: return V_Float;
+      case T_BoolConstant:  return V_Bool;
+      case T_Identifier: case T_FieldSelection: case T_Directive:
+      case T_LessEqual: case T_GreaterEqual: case T_EQ: case T_NE:
+      case T_And: case T_Or: case T_Inc: case T_Dec:
+      case T_Plus: case T_Dash: case T_Star: case T_Slash:
+      case T_AddAssign: case T_SubAssign: case T_MulAssign: case T_DivAssign:
+      case T_Equal: case T_RightAngle: case T_LeftAngle: case T_Question:
+        return V_Atom;
+      default:
+        return V_None;
+    }
+}
+
+TokenBuffer::TokenBuffer(const char *base, size_t length) {
+    source.base = base;
+    source.length = length;
+    size_t guess = length / 4 + 1;      // about one token per four bytes
+    kinds.reserve(guess);
+    offsets.reserve(guess);
+    lengths.reserve(guess);
+    lines.reserve(guess);
+    values.reserve(guess);
+}
+
+void TokenBuffer::Append(int kind, const YYSTYPE *lval, const yyltype *loc) {
+    kinds.push_back(kind);
+    if (kind == 0) {                    // end of input has no location
+        offsets.push_back(source.length);
+        lengths.push_back(0);
+        lines.push_back(0);
+        values.push_back(NoValue);
+        return;
+    }
+    offsets.push_back(loc->offset);
+    lengths.push_back(loc->length);
+    lines.push_back(loc->line);
+
+    TokenValue value;
+    switch (ValueKindOf(kind)) {
+      case V_None:    values.push_back(NoValue); return;
+      case V_Integer: value.integerConstant = lval->integerConstant; break;
+      case V_Uint:    value.uintConstant = lval->uintConstant; break;
+      case V_Float:   value.floatConstant = lval->floatConstant; break;
+      case V_Bool:    value.boolConstant = lval->boolConstant; break;
+      case V_Atom:    value.identifier = lval->identifier; break;
+    }
+    values.push_back(valueTable.size());
+    valueTable.push_back(value);
+}
+
+int TokenBuffer::Fetch(int i, YYSTYPE *lval, yyltype *loc) const {
+    if (i >= NumTokens() || kinds[i] == 0) return 0;
+    int kind = kinds[i];
+    loc->line = lines[i];
+    loc->offset = offsets[i];
+    loc->length = lengths[i];
+
+    if (values[i] == NoValue) return kind;
+    const TokenValue &value = valueTable[values[i]];
+    switch (ValueKindOf(kind)) {
+      case V_None:    break;
+      case V_Integer: lval->integerConstant = value.integerConstant; break;
+      case V_Uint:    lval->uintConstant = value.uintConstant; break;
+      case V_Float:   lval->floatConstant = value.floatConstant; break;
+      case V_Bool:    lval->boolConstant = value.boolConstant; break;
+      case V_Atom:    lval->identifier = value.identifier; break;
+    }
+    return kind;
+}
+
+/* Copies token i of from onto the end of this buffer, moved by
+ * offsetDelta bytes and lineDelta lines.
+ */
+void TokenBuffer::CopyToken(const TokenBuffer &from, int i,
+                            long offsetDelta, int lineDelta) {
+    kinds.push_back(from.kinds[i]);
+    lengths.push_back(from.lengths[i]);
+    if (from.kinds[i] == 0) {
+        offsets.push_back(source.length);
+        lines.push_back(0);
+    } else {
+        offsets.push_back(from.offsets[i] + offsetDelta);
+        lines.push_back(from.lines[i] + lineDelta);
+    }
+    if (from.values[i] == NoValue) {
+        values.push_back(NoValue);
+    } else {
+        values.push_back(valueTable.size());
+        valueTable.push_back(from.valueTable[from.values[i]]);
+    }
+}
+
+static bool SameValue(int kind, const TokenValue &a, const YYSTYPE &b) {
+    switch (ValueKindOf(kind)) {
+      case V_None:    return true;
+      case V_Integer: return a.integerConstant == b.integerConstant;
+      case V_Uint:    return a.uintConstant == b.uintConstant;
+      case V_Float:   return a.floatConstant == b.floatConstant;
+      case V_Bool:    return a.boolConstant == b.boolConstant;
+      case V_Atom:    return a.identifier == b.identifier;
+    }
+    return false;
+}
+
+/* Where to restart: a token just before the edit can change too (an
+ * identifier the edit extends), and deciding where a token ends can look
+ * two characters past it ("0x" needs a hex digit after it to be one
+ * token), so the scan starts at the last token ending strictly before
+ * the edit. Token starts are never inside a comment, so the lexer is in
+ * its normal state there unless the token before is a '.', in which
+ * case we back up past the field selection.
+ *
+ * The scan stops once a token comes out with the same kind, length
+ * and value as the old token at the same place past the edit (offset
+ * shifted by the size change), with the same '.' before it: the text
+ * from there on is unchanged and the lexer is in the same state, so the
+ * old tokens are right apart from offsets and lines. Columns are not
+ * stored, so an edit that moves tab stops does not hold this up; it
+ * usually resynchronizes at the first token after the edit.
+ */
+TokenBuffer *TokenBuffer::Relex(SourceBuffer *edited, const TextEdit &edit) const {
+    Assert(edit.offset + edit.removed <= source.length);
+    Assert(edited->GetLength() == source.length - edit.removed + edit.inserted);
+    long delta = (long)edit.inserted - (long)edit.removed;
+    int last = NumTokens() - 1;             // the end of input token
+
+    int restart = 0;
+    while (restart < last && offsets[restart] + lengths[restart] < edit.offset)
+        restart++;
+    if (restart > 0) restart--;
+    while (restart > 0 && kinds[restart-1] == T_Dot) restart--;
+
+    TokenBuffer *tokens = new TokenBuffer(edited->GetBase(), edited->GetLength());
+    for (int i = 0; i < restart; i++)
+        tokens->CopyToken(*this, i, 0, 0);
+
+    FastLexer lexer(edited);
+    if (restart > 0) {              // else from the top: the edit may precede token 0
+        int line = lines[restart];
+        std::vector<unsigned int> starts(source.lineStarts.begin(),
+                                         source.lineStarts.begin() + line);
+        lexer.RestartAt(offsets[restart], line, starts);
+    }
+
+    unsigned int oldEditEnd = edit.offset + edit.removed;
+    unsigned int newEditEnd = edit.offset + edit.inserted;
+    int old = restart;                      // old token to compare against
+    int scanned = 0;
+    YYSTYPE lval;
+    yyltype loc = {};
+    while (true) {
+        int kind = lexer.NextToken(&lval, &loc);
+        ScannerState *state = lexer.GetState();
+        if (kind == 0) {
+            tokens->Append(0, &lval, &loc);
+            tokens->source.lineStarts = state->lineStarts;
+            break;
+        }
+        if (loc.offset >= newEditEnd) {
+            long oldOffset = (long)loc.offset - delta;
+            while (old < last && offsets[old] < oldOffset) old++;
+            bool afterDot = !tokens->kinds.empty() && tokens->kinds.back() == T_Dot;
+            if (old < last && offsets[old] == oldOffset && offsets[old] >= oldEditEnd &&
+                kinds[old] == kind && lengths[old] == loc.length &&
+                (old > 0 && kinds[old-1] == T_Dot) == afterDot &&
+                (values[old] == NoValue || SameValue(kind, valueTable[values[old]], lval))) {
+                int lineDelta = loc.line - lines[old];
+                for (int i = old; i <= last; i++)
+                    tokens->CopyToken(*this, i, delta, lineDelta);
+                // The lexer has the lines up to where it stopped (past
+                // the token's own line if it is a continued directive)
+                tokens->source.lineStarts = state->lineStarts;
+                for (size_t n = state->lineStarts.size() - lineDelta;
+                     n < source.lineStarts.size(); n++)
+                    tokens->source.lineStarts.push_back(source.lineStarts[n] + delta);
+                break;
+            }
+        }
+        tokens->Append(kind, &lval, &loc);
+        scanned++;
+    }
+
+    PrintDebug("relex", "%d tokens kept, %d scanned again, %d shifted",
+               restart, scanned, tokens->NumTokens() - restart - scanned);
+    return tokens;
+}
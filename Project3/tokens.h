@@ -0,0 +1,93 @@
+/* File: tokens.h
+ * --------------
+ * A TokenBuffer holds the whole token stream of one source, scanned up
+ * front, so the parser can read tokens out of memory instead of calling
+ * the lexer once per token. It is what ParserSession::LexAhead() (the
+ * -tokens=buffer option) fills, and the form in which tokens can be
+ * kept, reused or looked ahead at.
+ *
+ * The tokens are stored as parallel arrays (a struct of arrays): token
+ * i has kind kinds[i], starts at byte offsets[i] of the source, spans
+ * lengths[i] bytes and starts on line lines[i]. If
+ * it carries a value (identifiers, operators, constants, directives)
+ * values[i] is the index of that value in valueTable; otherwise it is
+ * NoValue.
+ * Kinds are the token codes bison assigns in y.tab.h. The last token
+ * is always the end of input, kind 0.
+ *
+ * Relex() updates a buffer after an edit to its source without scanning
+ * all of it again, for editors that re-check as the user types.
+ */
+
+#ifndef _H_tokens
+#define _H_tokens
+
+#include <vector>
+#include "location.h"
+#include "atom.h"
+#include "scanner.h"
+#include "source.h"
+
+union YYSTYPE;
+
+/* Enum: ValueKind
+ * ---------------
+ * Which field of yylval the scanner fills in for a token.
+ */
+enum ValueKind { V_None, V_Integer, V_Uint, V_Float, V_Bool, V_Atom };
+ValueKind ValueKindOf(int token);
+
+/* Struct: TextEdit
+ * ----------------
+ * One edit to a source: removed bytes at offset were replaced by
+ * inserted bytes (either may be 0).
+ */
+struct TextEdit {
+    unsigned int offset, removed, inserted;
+};
+
+union TokenValue {
+    int integerConstant;
+    unsigned int uintConstant;
+    double floatConstant;
+    bool boolConstant;
+    Atom identifier;
+};
+
+class TokenBuffer
+{
+  public:
+    static constexpr unsigned int NoValue = ~0u;
+
+    std::vector<unsigned short> kinds;
+    std::vector<unsigned int> offsets, lengths;
+    std::vector<int> lines;
+    std::vector<unsigned int> values;
+    std::vector<TokenValue> valueTable;
+    ScannerState source;        // the source and its line starts
+
+    TokenBuffer(const char *base, size_t length);
+
+        // Adds a token as a lexer returned it
+    void Append(int kind, const YYSTYPE *lval, const yyltype *loc);
+
+        // Gives token i back the way the lexer did: fills in lval and
+        // the fields of loc a lexer sets, and returns the kind
+    int Fetch(int i, YYSTYPE *lval, yyltype *loc) const;
+
+        // Returns the tokens of edited, which is this buffer's source
+        // with edit applied. Only the stretch the edit can affect is
+        // scanned again (with FastLexer): from one token before the edit
+        // until a token comes out exactly as the old one at the same
+        // (shifted) place. The tokens after that are copied
+        // with their offsets and lines shifted. Diagnostics are issued
+        // only for the text scanned again.
+    TokenBuffer *Relex(SourceBuffer *edited, const TextEdit &edit) const;
+
+    int NumTokens() const       { return kinds.size(); }
+
+  protected:
+    void CopyToken(const TokenBuffer &from, int i, long offsetDelta, int lineDelta);
+};
+
+#endif
@@ -0,0 +1,258 @@
+/* File: unittest.cc
+ * -----------------
+ * Checks of pieces of the compiler that the samples do not reach on
+ * their own, built with make unittest (make check builds and runs it
+ * along with the scripts). Each check prints what went wrong, if
+ * anything; the program exits non-zero if any check failed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include "arena.h"
+#include "parser.h"
+#include "fastlex.h"
+#include "tokens.h"
+#include "source.h"
+#include "keywords.h"
+
+static int failures = 0;
+
+static void Expect(bool ok, const char *what) {
+    if (ok) return;
+    printf("FAILED: %s\n", what);
+    failures++;
+}
+
+/* An allocation too big to share a block, made first, gets a block of
+ * its own that must not be handed out again.
+ */
+static void CheckArenaOversizedFirst() {
+    Arena arena;
+    char *big = (char *)arena.Allocate(2000);
+    char *small = (char *)arena.Allocate(16);
+    Expect(small < big || small >= big + 2000,
+           "an allocation after an oversized first one overlaps it");
+    memset(big, 'a', 2000);
+    memset(small, 'b', 16);
+    Expect(big[0] == 'a' && big[1999] == 'a', "the oversized allocation was written over");
+
+    arena.Reset();
+    char *again = (char *)arena.Allocate(16);
+    char *after = (char *)arena.Allocate(16);
+    Expect(again != after, "allocations after Reset() overlap");
+}
+
+/* Allocations are aligned, distinct, and carry on across blocks. */
+static void CheckArenaBlocks() {
+    Arena arena;
+    char *last = NULL;
+    for (int i = 0; i < 10000; i++) {
+        char *p = (char *)arena.Allocate(1 + i % 40);
+        Expect(((size_t)p & (Arena::Align - 1)) == 0, "an allocation is not aligned");
+        Expect(p != last, "two allocations in a row are the same");
+        last = p;
+    }
+    char *big = (char *)arena.Allocate(Arena::BlockSize);
+    char *small = (char *)arena.Allocate(8);
+    Expect(small < big || small >= big + Arena::BlockSize,
+           "an allocation overlaps an oversized one");
+}
+
+/* Sends stdout and stderr to /dev/null until the matching Unsilence(),
+ * for checks whose lexing echoes text and reports errors as it should.
+ */
+static int savedOut, savedErr;
+
+static void Silence() {
+    fflush(stdout);
+    savedOut = dup(1);
+    savedErr = dup(2);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    dup2(null, 2);
+    close(null);
+}
+
+static void Unsilence() {
+    fflush(stdout);
+    dup2(savedOut, 1);
+    dup2(savedErr, 2);
+    close(savedOut);
+    close(savedErr);
+}
+
+/* The tokens of source, scanned in full */
+static TokenBuffer *ScanAll(SourceBuffer *source) {
+    FastLexer lexer(source);
+    TokenBuffer *tokens = new TokenBuffer(source->GetBase(), source->GetLength());
+    YYSTYPE lval;
+    yyltype loc = {};
+    int kind;
+    do {
+        kind = lexer.NextToken(&lval, &loc);
+        tokens->Append(kind, &lval, &loc);
+    } while (kind != 0);
+    tokens->source.lineStarts = lexer.GetState()->lineStarts;
+    return tokens;
+}
+
+static bool SameTokens(const TokenBuffer *a, const TokenBuffer *b) {
+    if (a->NumTokens() != b->NumTokens() || a->source.lineStarts != b->source.lineStarts)
+        return false;
+    for (int i = 0; i < a->NumTokens(); i++) {
+        YYSTYPE va, vb;
+        yyltype la = {}, lb = {};
+        int kind = a->Fetch(i, &va, &la);
+        if (b->Fetch(i, &vb, &lb) != kind || la.offset != lb.offset ||
+            la.length != lb.length || la.line != lb.line)
+            return false;
+        bool same = true;
+        switch (ValueKindOf(kind)) {
+          case V_None:    break;
+          case V_Integer: same = va.integerConstant == vb.integerConstant; break;
+          case V_Uint:    same = va.uintConstant == vb.uintConstant; break;
+          case V_Float:   same = va.floatConstant == vb.floatConstant; break;
+          case V_Bool:    same = va.boolConstant == vb.boolConstant; break;
+          case V_Atom:    same = va.identifier == vb.identifier; break;
+        }
+        if (!same) return false;
+    }
+    return true;
+}
+
+/* Relex() after an edit gives the same tokens as scanning the edited
+ * source in full. Each edit is made to the same original, at every
+ * offset in turn, replacing a few bytes with one of a set of snippets
+ * chosen to join, split and re-form tokens around the edit. Some
+ * edits make lexical errors (half a directive, say), which both scans
+ * report; they are not looked at here.
+ */
+static void CheckRelex() {
+    static const char *text =
+        "#define SCALE 2\\\n    + 1\n"
+        "uniform vec4 color;\n"
+        "// a comment\n"
+        "float f(float x, int n) {\n"
+        "\tfloat y = x * 1.5 + 0x1F;\n"
+        "\tcolor.xyz = color.zyx;\n"
+        "\tif (n >= 3 && y != 2.0) { y += 1u; } // done\n"
+        "\treturn y;\n"
+        "}\n";
+    static const char *snippets[] = {
+        "", "a", "1", " ", "\n", ".", "x.y", "0x", "=", "/", "// c\n", "\t", "9 z",
+    };
+    std::string original(text);
+    SourceBuffer before;
+    before.CopyText(original.data(), original.size());
+    TokenBuffer *tokens = ScanAll(&before);
+
+    int edits = 0, wrong = 0;
+    std::string report;
+    Silence();
+    for (unsigned int offset = 0; offset <= original.size(); offset++) {
+        for (unsigned int removed = 0; removed <= 2 && offset + removed <= original.size(); removed++) {
+            for (size_t s = 0; s < sizeof(snippets)/sizeof(snippets[0]); s++) {
+                std::string inserted(snippets[s]);
+                if (removed == 0 && inserted.empty()) continue;
+                std::string changed = original.substr(0, offset) + inserted +
+                                      original.substr(offset + removed);
+                SourceBuffer after;
+                after.CopyText(changed.data(), changed.size());
+                TextEdit edit = { offset, removed, (unsigned int)inserted.size() };
+                TokenBuffer *relexed = tokens->Relex(&after, edit);
+                TokenBuffer *scanned = ScanAll(&after);
+                edits++;
+                if (!SameTokens(relexed, scanned) && wrong++ < 5)
+                    report += "Relex() after replacing " + std::to_string(removed) +
+                              " bytes at " + std::to_string(offset) + " with \"" +
+                              inserted + "\" differs from a full scan\n";
+                delete relexed;
+                delete scanned;
+            }
+        }
+    }
+    Unsilence();
+    printf("%s", report.c_str());
+    Expect(wrong == 0, "Relex() gave different tokens than a full scan");
+    Expect(edits > 1000, "too few edits were tried");
+    delete tokens;
+}
+
+/* Every keyword in the array comes back as its token, and words near
+ * them (a prefix, one letter more) as identifiers.
+ */
+static void CheckKeywords() {
+    for (int i = 0; i < NumKeywords; i++) {
+        std::string word(keywords[i].spelling);
+        Expect(LookupKeyword(word.data(), word.size()) == keywords[i].token,
+               "a keyword is not recognized");
+        Expect(LookupKeyword(word.data(), word.size() - 1) == 0 ||
+               word.substr(0, word.size() - 1) == "in",
+               "a keyword's prefix is taken for a keyword");
+        word += "x";
+        Expect(LookupKeyword(word.data(), word.size()) == 0,
+               "a keyword with a letter added is taken for a keyword");
+    }
+}
+
+/* Compiles main, next to which each of headers (name, then text) is
+ * written first, and returns the number of errors.
+ */
+static int CompileWith(const char *main, const char **headers, int numHeaders) {
+    char dir[] = "/tmp/unittestXXXXXX";
+    if (!mkdtemp(dir)) return -1;
+    std::string path;
+    for (int i = 0; i < numHeaders; i++) {
+        path = std::string(dir) + "/" + headers[2*i];
+        FILE *f = fopen(path.c_str(), "w");
+        fputs(headers[2*i+1], f);
+        fclose(f);
+    }
+    path = std::string(dir) + "/main.glsl";
+    SourceBuffer source;
+    source.CopyText(main, strlen(main));
+    Silence();
+    ParserSession session(&source, L_Fast);
+    session.SetFileName(path.c_str());
+    int errors = session.Parse();
+    Unsilence();
+    for (int i = 0; i < numHeaders; i++)
+        unlink((std::string(dir) + "/" + headers[2*i]).c_str());
+    rmdir(dir);
+    return errors;
+}
+
+/* A file wrapped in #ifndef X / #define X ... #endif is read once; one
+ * whose outer group has an #else is not an include guard, and its
+ * #else branch takes effect on the second #include.
+ */
+static void CheckIncludeGuards() {
+    static const char *guarded[] = {
+        "guarded.h", "#ifndef GUARDED_H\n#define GUARDED_H\nint a;\n#endif\n",
+    };
+    Expect(CompileWith("#include \"guarded.h\"\n#include \"guarded.h\"\n"
+                       "void main() { a = 1; }\n", guarded, 1) == 0,
+           "a guarded header included twice was read twice");
+
+    static const char *withElse[] = {
+        "else.h", "#ifndef ELSE_H\n#define ELSE_H\nint a;\n#else\nint b;\n#endif\n",
+    };
+    Expect(CompileWith("#include \"else.h\"\n#include \"else.h\"\n"
+                       "void main() { a = 1; b = 2; }\n", withElse, 1) == 0,
+           "the #else branch of a header included twice was skipped");
+}
+
+int main() {
+    InitParser();
+    CheckArenaOversizedFirst();
+    CheckArenaBlocks();
+    CheckRelex();
+    CheckKeywords();
+    CheckIncludeGuards();
+    if (failures == 0) printf("All unit checks passed\n");
+    return failures > 0;
+}
@@ -11,6 +11,8 @@
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> options;     // "name=value", from -name=value
+static vector<const char*> inputFiles;
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...) {
@@ -58,19 +60,57 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
+/* The options given without a value, as -name */
+static const char *flags[] = { "syntax-only", "lazy-bodies" };
+
+static bool IsFlag(const char *name) {
+  for (unsigned int i = 0; i < sizeof(flags)/sizeof(*flags); i++)
+    if (!strcmp(name, flags[i])) return true;
+  return false;
+}
+
 void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
+  int i = 1;
+  for (; i < argc && strcmp(argv[i], "-d") != 0; i++) {
+    if (argv[i][0] != '-')                       // input file name
+      inputFiles.push_back(argv[i]);
+    else if (strchr(argv[i], '=') || IsFlag(argv[i] + 1))
+      options.push_back(argv[i] + 1);
+    else {
+      printf("Incorrect Use:   ");
+      for (int j = 1; j < argc; j++) printf("%s ", argv[j]);
+      printf("\n");
+      printf("Correct Usage:   [file ...] [-lexer=fast|flex|diff|stream] "
+             "[-parser=bison|rd]\n"
+             "                 [-tokens=buffer|pull|thread] [-token-cache=<dir>] "
+             "[-include-path=<dirs>]\n"
+             "                 [-prelude=<file>] [-fingerprint=print|only] "
+             "[-syntax-only] [-lazy-bodies]\n"
+             "                 -d <debug-key-1> <debug-key-2> ... \n");
+      exit(2);
+    }
   }
 
-  for (int i = 2; i < argc; i++)
+  for (i++; i < argc; i++)
     SetDebugForKey(argv[i], true);
 }
 
+const char *GetOption(const char *name) {
+  size_t len = strlen(name);
+  for (unsigned int i = 0; i < options.size(); i++)
+    if (!strncmp(options[i], name, len)) {
+      if (options[i][len] == '=') return options[i] + len + 1;
+      if (options[i][len] == '\0') return options[i] + len;   // ""
+    }
+
+  return NULL;
+}
+
+const char *GetInputFile(int n) {
+  return n < inputFiles.size() ? inputFiles[n] : NULL;
+}
+
+int NumInputFiles() {
+  return inputFiles.size();
+}
+
@@ -76,11 +76,34 @@ bool IsDebugOn(const char *key);
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags from the command line.  Input file
+ * names (any number, none to read standard input) and any options of
+ * the form -name=value (or -name, for the few that take no value) may
+ * come first; after them, verifies that the next argument is -d, and
+ * then interpret all the arguments that follow as being flags to turn on.
  */
 
 void ParseCommandLine(int argc, char *argv[]);
+
+/**
+ * Function: GetInputFile
+ * ----------------------
+ * Returns the nth input file named on the command line, or NULL if
+ * there is none (with no files at all, the program should read
+ * standard input).
+ */
+
+const char *GetInputFile(int n = 0);
+int NumInputFiles();
+
+/**
+ * Function: GetOption
+ * Usage: const char *lexer = GetOption("lexer");
+ * ----------------------------------------------
+ * Returns the value given with -name=value on the command line, "" if
+ * it was given as a bare -name, or NULL if the option was not given.
+ */
+
+const char *GetOption(const char *name);
      
 #endif